@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "ModularArithmetic.h"
+#include "Parallel.h"
+
+// Table of baby steps g^i -> i for i < size, split into shards by value so that threads fill them independently
+class BabyStepTable {
+public:
+    BabyStepTable(const ModularArithmetic &ma, uint64_t g, uint64_t size, unsigned threads)
+            : size_(size), shards_(std::max(threads, 1u)) {
+        unsigned shard_count = shards_.size();
+
+        // pass 1: every thread computes a contiguous range of powers and buckets them by shard
+        std::vector<std::vector<std::vector<std::pair<uint64_t, uint64_t>>>> buckets(
+                shard_count, std::vector<std::vector<std::pair<uint64_t, uint64_t>>>(shard_count));
+        runThreads(shard_count, [&](unsigned t) {
+            uint64_t begin = size * t / shard_count;
+            uint64_t end = size * (t + 1) / shard_count;
+            uint64_t baby_step = ma.pow(g, begin);
+            for (uint64_t i = begin; i < end; ++i) {
+                buckets[t][shardOf(baby_step)].emplace_back(baby_step, i);
+                baby_step = ma.mul(baby_step, g); // g^(i+1)
+            }
+        });
+
+        // pass 2: every thread owns one shard, buckets are visited in increasing i so the smallest i wins
+        runThreads(shard_count, [&](unsigned s) {
+            size_t total = 0;
+            for (unsigned t = 0; t < shard_count; ++t) {
+                total += buckets[t][s].size();
+            }
+            shards_[s].reserve(total);
+            for (unsigned t = 0; t < shard_count; ++t) {
+                for (const auto &[value, i]: buckets[t][s]) {
+                    shards_[s].emplace(value, i);
+                }
+            }
+        });
+    }
+
+    uint64_t size() const {
+        return size_;
+    }
+
+    bool find(uint64_t value, uint64_t &i) const {
+        const auto &shard = shards_[shardOf(value)];
+        auto it = shard.find(value);
+        if (it == shard.end()) {
+            return false;
+        }
+        i = it->second;
+        return true;
+    }
+
+private:
+    uint64_t size_;
+    std::vector<std::unordered_map<uint64_t, uint64_t>> shards_;
+
+    unsigned shardOf(uint64_t value) const {
+        return (unsigned) (value % shards_.size());
+    }
+};
+
+/*
+ * Smallest x < giant_steps * table.size() with g^x == y, using the baby steps g^i from the table.
+ * Giant steps y * g^(-jn) are split into contiguous ranges of j, one per thread.
+ * Threads stop as soon as a hit with a smaller j is known, so the answer does not depend on the thread count.
+ */
+bool babyStepGiantStep(const ModularArithmetic &ma, const BabyStepTable &table, uint64_t g, uint64_t y,
+                       uint64_t giant_steps, unsigned threads, uint64_t &x) {
+    threads = std::max(threads, 1u);
+    uint64_t n = table.size();
+    uint64_t giant_stride = ma.inv(ma.pow(g, n)); // g^(-n)
+
+    std::atomic<uint64_t> found_j{giant_steps};
+    std::vector<uint64_t> found_i(threads, 0);
+    runThreads(threads, [&](unsigned t) {
+        uint64_t begin = giant_steps * t / threads;
+        uint64_t end = giant_steps * (t + 1) / threads;
+        uint64_t giant_step = ma.mul(y, ma.pow(giant_stride, begin)); // y * g^(-jn)
+        for (uint64_t j = begin; j < end && j < found_j.load(std::memory_order_relaxed); ++j) {
+            uint64_t i;
+            if (table.find(giant_step, i)) {
+                found_i[t] = i;
+                uint64_t found = found_j.load();
+                while (j < found && !found_j.compare_exchange_weak(found, j)) {}
+                return;
+            }
+            giant_step = ma.mul(giant_step, giant_stride);
+        }
+    });
+
+    uint64_t j = found_j.load();
+    if (j == giant_steps) {
+        return false;
+    }
+    unsigned owner = 0;
+    while (giant_steps * (owner + 1) / threads <= j) {
+        ++owner;
+    }
+    x = j * n + found_i[owner];
+    return true;
+}
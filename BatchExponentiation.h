@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Exponentiation.h"
+#include "ModularArithmetic.h"
+#include "Montgomery.h"
+
+/*
+ * Many exponentiations under one modulus, several independent ones at a time.
+ * Odd moduli run 4 interleaved Montgomery chains, so the 64x64->128 bit multiplications of different values
+ * overlap in the pipeline. There is no vector kernel: AVX2 has no 64x64->128 bit multiply, and building one
+ * from 32-bit partial products costs about as many instructions as the scalar lanes, while every modulus
+ * in the tools is 48 to 64 bits wide. Everything else goes through ModularArithmetic::pow one value at a time.
+ */
+constexpr size_t BATCH_SCALAR_LANES = 4;
+
+// 4 independent Montgomery values per element, so the multiplications of different lanes overlap
+struct MontgomeryLanes {
+    using Element = std::array<uint64_t, BATCH_SCALAR_LANES>;
+
+    const MontgomeryContext<uint64_t> &mont;
+
+    Element one() const {
+        Element res;
+        res.fill(mont.one());
+        return res;
+    }
+
+    Element mul(const Element &a, const Element &b) const {
+        Element res;
+        for (size_t k = 0; k < BATCH_SCALAR_LANES; ++k) {
+            res[k] = mont.mul(a[k], b[k]);
+        }
+        return res;
+    }
+
+    Element sqr(const Element &a) const {
+        return mul(a, a);
+    }
+};
+
+inline void batchPowScalar(const MontgomeryContext<uint64_t> &mont, const uint64_t *bases, size_t count,
+                           uint64_t exponent, uint64_t *res) {
+    MontgomeryLanes lanes{mont};
+    for (size_t i = 0; i < count; i += BATCH_SCALAR_LANES) {
+        MontgomeryLanes::Element base;
+        for (size_t k = 0; k < BATCH_SCALAR_LANES; ++k) {
+            base[k] = mont.toMontgomery(i + k < count ? bases[i + k] : 0);
+        }
+        MontgomeryLanes::Element power = slidingWindowPow(lanes, base, exponent);
+        for (size_t k = 0; k < BATCH_SCALAR_LANES && i + k < count; ++k) {
+            res[i + k] = mont.fromMontgomery(power[k]);
+        }
+    }
+}
+
+// res[i] = bases[i]^exponent mod the modulus of ma for i < count, res may be the same array as bases
+inline void batchPow(const ModularArithmetic &ma, const uint64_t *bases, size_t count, uint64_t exponent,
+                     uint64_t *res) {
+    if (ma.montgomery().isValid() && exponent != 0) {
+        batchPowScalar(ma.montgomery(), bases, count, exponent, res);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        res[i] = ma.pow(bases[i], exponent);
+    }
+}
+
+// res[i] = bases[i]^exponent mod the modulus of ma
+inline std::vector<uint64_t> batchPow(const ModularArithmetic &ma, const std::vector<uint64_t> &bases,
+                                      uint64_t exponent) {
+    std::vector<uint64_t> res(bases.size());
+    batchPow(ma, bases.data(), bases.size(), exponent, res.data());
+    return res;
+}
+
+// res[i] = bases[i]^exponents[i] mod the modulus of ma
+inline std::vector<uint64_t> batchPow(const ModularArithmetic &ma, const std::vector<uint64_t> &bases,
+                                      const std::vector<uint64_t> &exponents) {
+    std::vector<uint64_t> res(bases.size());
+    for (size_t i = 0; i < bases.size(); ++i) {
+        res[i] = ma.pow(bases[i], exponents[i]);
+    }
+    return res;
+}
+
+/*
+ * Powers of one fixed base: table[i][d] = base^(d * 2^(w*i)), so base^x costs one multiplication per
+ * nonzero w-bit digit of x and no squarings. The table pays off once the same base is raised many times.
+ */
+class FixedBasePow {
+public:
+    static constexpr unsigned WINDOW = 8;
+    static constexpr unsigned COLUMNS = 64 / WINDOW;
+
+    FixedBasePow(const ModularArithmetic &ma, uint64_t base) : ma_(ma), table_(COLUMNS << WINDOW) {
+        const MontgomeryContext<uint64_t> &mont = ma_.montgomery();
+        uint64_t column_base = mont.isValid() ? mont.toMontgomery(base) : base % ma_.modulus();
+        for (unsigned i = 0; i < COLUMNS; ++i) {
+            uint64_t *column = &table_[i << WINDOW];
+            column[0] = one();
+            for (unsigned d = 1; d < (1u << WINDOW); ++d) {
+                column[d] = mul(column[d - 1], column_base);
+            }
+            column_base = mul(column[(1u << WINDOW) - 1], column_base); // base^(2^(w*(i+1)))
+        }
+    }
+
+    uint64_t pow(uint64_t exponent) const {
+        uint64_t res = one();
+        for (unsigned i = 0; exponent != 0; ++i, exponent >>= WINDOW) {
+            unsigned digit = exponent & ((1u << WINDOW) - 1);
+            if (digit != 0) {
+                res = mul(res, table_[(i << WINDOW) + digit]);
+            }
+        }
+        const MontgomeryContext<uint64_t> &mont = ma_.montgomery();
+        return mont.isValid() ? mont.fromMontgomery(res) : res;
+    }
+
+    std::vector<uint64_t> pow(const std::vector<uint64_t> &exponents) const {
+        std::vector<uint64_t> res(exponents.size());
+        for (size_t i = 0; i < exponents.size(); ++i) {
+            res[i] = pow(exponents[i]);
+        }
+        return res;
+    }
+
+private:
+    ModularArithmetic ma_;
+    std::vector<uint64_t> table_; // COLUMNS rows of 2^WINDOW entries, Montgomery form when the modulus is odd
+
+    uint64_t one() const {
+        return ma_.montgomery().isValid() ? ma_.montgomery().one() : 1 % ma_.modulus();
+    }
+
+    uint64_t mul(uint64_t a, uint64_t b) const {
+        return ma_.montgomery().isValid() ? ma_.montgomery().mul(a, b) : ma_.mul(a, b);
+    }
+};
@@ -0,0 +1,487 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Non-negative arbitrary precision integer.
+// Little-endian 64-bit limbs without leading zero limbs, zero has no limbs at all.
+class BigInt {
+public:
+    using Limb = uint64_t;
+
+    // below this many limbs schoolbook multiplication beats Karatsuba
+    static constexpr size_t KARATSUBA_THRESHOLD = 40;
+
+    BigInt() = default;
+
+    BigInt(uint64_t value) {
+        if (value != 0) {
+            limbs_.push_back(value);
+        }
+    }
+
+    static BigInt fromLimbs(std::vector<Limb> limbs) {
+        BigInt res;
+        res.limbs_ = std::move(limbs);
+        res.normalize();
+        return res;
+    }
+
+    // decimal, or hexadecimal with "0x" prefix
+    static BigInt fromString(const std::string &str) {
+        BigInt res;
+        bool hex = str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X');
+        for (size_t i = hex ? 2 : 0; i < str.size(); ++i) {
+            char c = str[i];
+            uint64_t digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (hex && c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else if (hex && c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            } else {
+                continue; // separators
+            }
+            res.mulAddSmall(hex ? 16 : 10, digit);
+        }
+        return res;
+    }
+
+    // big-endian bytes
+    static BigInt fromBytes(const uint8_t *data, size_t size) {
+        BigInt res;
+        res.limbs_.assign((size + 7) / 8, 0);
+        for (size_t i = 0; i < size; ++i) {
+            res.limbs_[i / 8] |= (Limb) data[size - 1 - i] << (8 * (i % 8));
+        }
+        res.normalize();
+        return res;
+    }
+
+    // big-endian bytes, left-padded with zeros to the given size
+    std::vector<uint8_t> toBytes(size_t size) const {
+        std::vector<uint8_t> res(size, 0);
+        for (size_t i = 0; i < size && i / 8 < limbs_.size(); ++i) {
+            res[size - 1 - i] = (uint8_t) (limbs_[i / 8] >> (8 * (i % 8)));
+        }
+        return res;
+    }
+
+    static BigInt powerOfTwo(size_t exponent) {
+        BigInt res;
+        res.limbs_.assign(exponent / 64 + 1, 0);
+        res.limbs_.back() = (Limb) 1 << (exponent % 64);
+        return res;
+    }
+
+    std::string toString() const {
+        if (isZero()) {
+            return "0";
+        }
+
+        const uint64_t chunk = 10000000000000000000ULL; // 10^19
+        std::vector<uint64_t> chunks;
+        BigInt rest = *this;
+        while (!rest.isZero()) {
+            chunks.push_back(rest.divSmall(chunk));
+        }
+
+        std::string res = std::to_string(chunks.back());
+        for (size_t i = chunks.size() - 1; i-- > 0;) {
+            std::string part = std::to_string(chunks[i]);
+            res += std::string(19 - part.size(), '0') + part;
+        }
+        return res;
+    }
+
+    bool isZero() const {
+        return limbs_.empty();
+    }
+
+    bool isOdd() const {
+        return !limbs_.empty() && (limbs_[0] & 1);
+    }
+
+    size_t bitLength() const {
+        if (limbs_.empty()) {
+            return 0;
+        }
+        return limbs_.size() * 64 - __builtin_clzll(limbs_.back());
+    }
+
+    bool testBit(size_t i) const {
+        return i / 64 < limbs_.size() && ((limbs_[i / 64] >> (i % 64)) & 1);
+    }
+
+    size_t limbCount() const {
+        return limbs_.size();
+    }
+
+    Limb limb(size_t i) const {
+        return i < limbs_.size() ? limbs_[i] : 0;
+    }
+
+    const std::vector<Limb> &limbs() const {
+        return limbs_;
+    }
+
+    // low 64 bits
+    uint64_t toUint64() const {
+        return limb(0);
+    }
+
+    // remainder of division by a single limb
+    uint64_t modSmall(uint64_t divisor) const {
+        assert(divisor != 0);
+        unsigned __int128 rem = 0;
+        for (size_t i = limbs_.size(); i-- > 0;) {
+            rem = ((rem << 64) | limbs_[i]) % divisor;
+        }
+        return (uint64_t) rem;
+    }
+
+    static int compare(const BigInt &a, const BigInt &b) {
+        if (a.limbs_.size() != b.limbs_.size()) {
+            return a.limbs_.size() < b.limbs_.size() ? -1 : 1;
+        }
+        for (size_t i = a.limbs_.size(); i-- > 0;) {
+            if (a.limbs_[i] != b.limbs_[i]) {
+                return a.limbs_[i] < b.limbs_[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    friend bool operator==(const BigInt &a, const BigInt &b) { return a.limbs_ == b.limbs_; }
+    friend bool operator!=(const BigInt &a, const BigInt &b) { return a.limbs_ != b.limbs_; }
+    friend bool operator<(const BigInt &a, const BigInt &b) { return compare(a, b) < 0; }
+    friend bool operator<=(const BigInt &a, const BigInt &b) { return compare(a, b) <= 0; }
+    friend bool operator>(const BigInt &a, const BigInt &b) { return compare(a, b) > 0; }
+    friend bool operator>=(const BigInt &a, const BigInt &b) { return compare(a, b) >= 0; }
+
+    BigInt &operator+=(const BigInt &other) {
+        if (limbs_.size() < other.limbs_.size()) {
+            limbs_.resize(other.limbs_.size(), 0);
+        }
+        Limb carry = 0;
+        for (size_t i = 0; i < limbs_.size(); ++i) {
+            unsigned __int128 sum = (unsigned __int128) limbs_[i] + other.limb(i) + carry;
+            limbs_[i] = (Limb) sum;
+            carry = (Limb) (sum >> 64);
+            if (carry == 0 && i >= other.limbs_.size()) {
+                break;
+            }
+        }
+        if (carry != 0) {
+            limbs_.push_back(carry);
+        }
+        return *this;
+    }
+
+    // requires *this >= other
+    BigInt &operator-=(const BigInt &other) {
+        assert(*this >= other);
+        Limb borrow = 0;
+        for (size_t i = 0; i < limbs_.size(); ++i) {
+            Limb sub = other.limb(i);
+            Limb res = limbs_[i] - sub - borrow;
+            borrow = (limbs_[i] < sub || (limbs_[i] == sub && borrow)) ? 1 : 0;
+            limbs_[i] = res;
+            if (borrow == 0 && i >= other.limbs_.size()) {
+                break;
+            }
+        }
+        normalize();
+        return *this;
+    }
+
+    BigInt &operator*=(const BigInt &other) {
+        *this = *this * other;
+        return *this;
+    }
+
+    BigInt &operator/=(const BigInt &other) {
+        BigInt quotient, remainder;
+        divMod(*this, other, quotient, remainder);
+        *this = std::move(quotient);
+        return *this;
+    }
+
+    BigInt &operator%=(const BigInt &other) {
+        BigInt quotient, remainder;
+        divMod(*this, other, quotient, remainder);
+        *this = std::move(remainder);
+        return *this;
+    }
+
+    BigInt &operator<<=(size_t shift) {
+        if (isZero() || shift == 0) {
+            return *this;
+        }
+        size_t limb_shift = shift / 64;
+        unsigned bit_shift = shift % 64;
+        limbs_.insert(limbs_.begin(), limb_shift, 0);
+        if (bit_shift != 0) {
+            limbs_.push_back(0);
+            for (size_t i = limbs_.size() - 1; i > limb_shift; --i) {
+                limbs_[i] = (limbs_[i] << bit_shift) | (limbs_[i - 1] >> (64 - bit_shift));
+            }
+            limbs_[limb_shift] <<= bit_shift;
+        }
+        normalize();
+        return *this;
+    }
+
+    BigInt &operator>>=(size_t shift) {
+        size_t limb_shift = shift / 64;
+        unsigned bit_shift = shift % 64;
+        if (limb_shift >= limbs_.size()) {
+            limbs_.clear();
+            return *this;
+        }
+        limbs_.erase(limbs_.begin(), limbs_.begin() + (long) limb_shift);
+        if (bit_shift != 0) {
+            for (size_t i = 0; i + 1 < limbs_.size(); ++i) {
+                limbs_[i] = (limbs_[i] >> bit_shift) | (limbs_[i + 1] << (64 - bit_shift));
+            }
+            limbs_.back() >>= bit_shift;
+        }
+        normalize();
+        return *this;
+    }
+
+    friend BigInt operator+(BigInt a, const BigInt &b) { return a += b; }
+    friend BigInt operator-(BigInt a, const BigInt &b) { return a -= b; }
+    friend BigInt operator/(BigInt a, const BigInt &b) { return a /= b; }
+    friend BigInt operator%(BigInt a, const BigInt &b) { return a %= b; }
+    friend BigInt operator<<(BigInt a, size_t shift) { return a <<= shift; }
+    friend BigInt operator>>(BigInt a, size_t shift) { return a >>= shift; }
+
+    friend BigInt operator*(const BigInt &a, const BigInt &b) {
+        if (a.isZero() || b.isZero()) {
+            return BigInt();
+        }
+        BigInt res;
+        res.limbs_ = multiply(a.limbs_.data(), a.limbs_.size(), b.limbs_.data(), b.limbs_.size());
+        res.normalize();
+        return res;
+    }
+
+    BigInt &operator++() {
+        return *this += BigInt(1);
+    }
+
+    BigInt &operator--() {
+        return *this -= BigInt(1);
+    }
+
+    // Knuth's algorithm D, quotient and remainder of u / v
+    static void divMod(const BigInt &u, const BigInt &v, BigInt &quotient, BigInt &remainder) {
+        assert(!v.isZero());
+        if (u < v) {
+            quotient = BigInt();
+            remainder = u;
+            return;
+        }
+        if (v.limbs_.size() == 1) {
+            quotient = u;
+            remainder = BigInt(quotient.divSmall(v.limbs_[0]));
+            return;
+        }
+
+        size_t n = v.limbs_.size();
+        size_t m = u.limbs_.size() - n;
+        unsigned shift = __builtin_clzll(v.limbs_.back());
+
+        // normalize so that the top limb of the divisor has its high bit set
+        std::vector<Limb> vn = shiftedLeft(v.limbs_, shift, n);
+        std::vector<Limb> un = shiftedLeft(u.limbs_, shift, u.limbs_.size() + 1);
+
+        std::vector<Limb> q(m + 1, 0);
+        for (size_t j = m + 1; j-- > 0;) {
+            unsigned __int128 num = ((unsigned __int128) un[j + n] << 64) | un[j + n - 1];
+            unsigned __int128 qhat = num / vn[n - 1];
+            unsigned __int128 rhat = num % vn[n - 1];
+            while ((qhat >> 64) != 0 || qhat * vn[n - 2] > ((rhat << 64) | un[j + n - 2])) {
+                --qhat;
+                rhat += vn[n - 1];
+                if ((rhat >> 64) != 0) {
+                    break;
+                }
+            }
+
+            // un[j..j+n] -= qhat * vn
+            Limb carry = 0;
+            Limb borrow = 0;
+            for (size_t i = 0; i < n; ++i) {
+                unsigned __int128 product = qhat * vn[i] + carry;
+                carry = (Limb) (product >> 64);
+                Limb product_lo = (Limb) product;
+                Limb diff = un[i + j] - product_lo;
+                Limb next_borrow = un[i + j] < product_lo;
+                next_borrow += diff < borrow;
+                un[i + j] = diff - borrow;
+                borrow = next_borrow;
+            }
+            unsigned __int128 top_sub = (unsigned __int128) carry + borrow;
+            bool negative = un[j + n] < top_sub;
+            un[j + n] -= (Limb) top_sub;
+
+            if (negative) { // qhat was one too big, add the divisor back
+                --qhat;
+                Limb add_carry = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    unsigned __int128 sum = (unsigned __int128) un[i + j] + vn[i] + add_carry;
+                    un[i + j] = (Limb) sum;
+                    add_carry = (Limb) (sum >> 64);
+                }
+                un[j + n] += add_carry;
+            }
+            q[j] = (Limb) qhat;
+        }
+
+        quotient = fromLimbs(std::move(q));
+        un.resize(n);
+        remainder = fromLimbs(std::move(un)) >> shift;
+    }
+
+    // *this /= divisor, returns the remainder
+    uint64_t divSmall(uint64_t divisor) {
+        assert(divisor != 0);
+        unsigned __int128 rem = 0;
+        for (size_t i = limbs_.size(); i-- > 0;) {
+            unsigned __int128 cur = (rem << 64) | limbs_[i];
+            limbs_[i] = (Limb) (cur / divisor);
+            rem = cur % divisor;
+        }
+        normalize();
+        return (uint64_t) rem;
+    }
+
+private:
+    std::vector<Limb> limbs_;
+
+    void normalize() {
+        while (!limbs_.empty() && limbs_.back() == 0) {
+            limbs_.pop_back();
+        }
+    }
+
+    void mulAddSmall(uint64_t factor, uint64_t addend) {
+        Limb carry = addend;
+        for (Limb &limb: limbs_) {
+            unsigned __int128 cur = (unsigned __int128) limb * factor + carry;
+            limb = (Limb) cur;
+            carry = (Limb) (cur >> 64);
+        }
+        if (carry != 0) {
+            limbs_.push_back(carry);
+        }
+    }
+
+    static std::vector<Limb> shiftedLeft(const std::vector<Limb> &limbs, unsigned shift, size_t size) {
+        std::vector<Limb> res(size, 0);
+        for (size_t i = 0; i < limbs.size(); ++i) {
+            res[i] |= limbs[i] << shift;
+            if (shift != 0 && i + 1 < size) {
+                res[i + 1] = limbs[i] >> (64 - shift);
+            }
+        }
+        return res;
+    }
+
+    // res[0..n+m) = a * b
+    static void mulSchoolbook(const Limb *a, size_t n, const Limb *b, size_t m, Limb *res) {
+        std::fill(res, res + n + m, 0);
+        for (size_t i = 0; i < n; ++i) {
+            Limb carry = 0;
+            for (size_t j = 0; j < m; ++j) {
+                unsigned __int128 cur = (unsigned __int128) a[i] * b[j] + res[i + j] + carry;
+                res[i + j] = (Limb) cur;
+                carry = (Limb) (cur >> 64);
+            }
+            res[i + m] = carry;
+        }
+    }
+
+    // res += a, returns the carry out of res
+    static Limb addInto(Limb *res, size_t res_size, const Limb *a, size_t n) {
+        Limb carry = 0;
+        for (size_t i = 0; i < res_size && (i < n || carry != 0); ++i) {
+            unsigned __int128 sum = (unsigned __int128) res[i] + (i < n ? a[i] : 0) + carry;
+            res[i] = (Limb) sum;
+            carry = (Limb) (sum >> 64);
+        }
+        return carry;
+    }
+
+    // res -= a, res must not become negative
+    static void subFrom(Limb *res, size_t res_size, const Limb *a, size_t n) {
+        Limb borrow = 0;
+        for (size_t i = 0; i < res_size && (i < n || borrow != 0); ++i) {
+            Limb sub = i < n ? a[i] : 0;
+            Limb diff = res[i] - sub - borrow;
+            borrow = (res[i] < sub || (res[i] == sub && borrow)) ? 1 : 0;
+            res[i] = diff;
+        }
+    }
+
+    static std::vector<Limb> multiply(const Limb *a, size_t n, const Limb *b, size_t m) {
+        std::vector<Limb> res(n + m, 0);
+        if (std::min(n, m) < KARATSUBA_THRESHOLD) {
+            mulSchoolbook(a, n, b, m, res.data());
+            return res;
+        }
+
+        // a = a1 * B^half + a0, b = b1 * B^half + b0
+        size_t half = std::max(n, m) / 2;
+        size_t a0_size = std::min(n, half), b0_size = std::min(m, half);
+        size_t a1_size = n - a0_size, b1_size = m - b0_size;
+
+        std::vector<Limb> z0 = multiply(a, a0_size, b, b0_size);
+        std::vector<Limb> z2;
+        if (a1_size != 0 && b1_size != 0) {
+            z2 = multiply(a + half, a1_size, b + half, b1_size);
+        }
+
+        // z1 = (a0 + a1) * (b0 + b1) - z0 - z2
+        std::vector<Limb> a_sum(a, a + a0_size);
+        a_sum.resize(std::max(a0_size, a1_size) + 1, 0);
+        addInto(a_sum.data(), a_sum.size(), a + half, a1_size);
+        std::vector<Limb> b_sum(b, b + b0_size);
+        b_sum.resize(std::max(b0_size, b1_size) + 1, 0);
+        addInto(b_sum.data(), b_sum.size(), b + half, b1_size);
+        std::vector<Limb> z1 = multiply(a_sum.data(), a_sum.size(), b_sum.data(), b_sum.size());
+        subFrom(z1.data(), z1.size(), z0.data(), z0.size());
+        subFrom(z1.data(), z1.size(), z2.data(), z2.size());
+
+        std::copy(z0.begin(), z0.end(), res.begin());
+        addInto(res.data() + half, res.size() - half, z1.data(), std::min(z1.size(), res.size() - half));
+        if (!z2.empty()) {
+            addInto(res.data() + 2 * half, res.size() - 2 * half, z2.data(),
+                    std::min(z2.size(), res.size() - 2 * half));
+        }
+        return res;
+    }
+};
+
+inline size_t bitLength(const BigInt &x) {
+    return x.bitLength();
+}
+
+inline bool testBit(const BigInt &x, size_t i) {
+    return x.testBit(i);
+}
+
+inline BigInt mulMod(const BigInt &a, const BigInt &b, const BigInt &modulus) {
+    return a * b % modulus;
+}
+
+inline std::ostream &operator<<(std::ostream &os, const BigInt &x) {
+    return os << x.toString();
+}
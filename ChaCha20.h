@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "CpuFeatures.h"
+#include "functions.h"
+
+/*
+ * ChaCha20 keystream (original layout: 64-bit block counter in words 12-13, 64-bit stream id in words 14-15).
+ * Different stream ids under one key give independent keystreams, which is how per-thread generators are derived.
+ * With AVX2, 8 blocks are computed at once, one block per 32-bit lane; the output does not depend on the path taken.
+ */
+class ChaCha20 {
+public:
+    static constexpr size_t BLOCK_WORDS = 16;
+    static constexpr size_t AVX2_BLOCKS = 8;
+
+    ChaCha20(const std::array<uint32_t, 8> &key, uint64_t stream, uint64_t counter = 0) {
+        state_ = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574}; // "expand 32-byte k"
+        std::copy(key.begin(), key.end(), state_.begin() + 4);
+        state_[12] = (uint32_t) counter;
+        state_[13] = (uint32_t) (counter >> 32);
+        state_[14] = (uint32_t) stream;
+        state_[15] = (uint32_t) (stream >> 32);
+    }
+
+    // key expanded from a 64-bit seed, for reproducible runs rather than secrecy of the seed itself
+    static std::array<uint32_t, 8> keyFromSeed(uint64_t seed) {
+        std::array<uint32_t, 8> key;
+        for (size_t i = 0; i < key.size(); i += 2) {
+            uint64_t word = mixHash(mixHash(seed + (i / 2 + 1) * 0x9E3779B97F4A7C15ULL));
+            key[i] = (uint32_t) word;
+            key[i + 1] = (uint32_t) (word >> 32);
+        }
+        return key;
+    }
+
+    // next blocks * BLOCK_WORDS words of the keystream
+    void generate(uint32_t *out, size_t blocks) {
+#ifdef X86_DISPATCH
+        if (hasAvx2()) {
+            for (; blocks >= AVX2_BLOCKS; blocks -= AVX2_BLOCKS, out += AVX2_BLOCKS * BLOCK_WORDS) {
+                blocksAvx2(state_.data(), out);
+                advance(AVX2_BLOCKS);
+            }
+        }
+#endif
+        for (; blocks > 0; --blocks, out += BLOCK_WORDS) {
+            block(state_.data(), out);
+            advance(1);
+        }
+    }
+
+    // 20 rounds over one input block plus the feed-forward
+    static void block(const uint32_t *in, uint32_t *out) {
+        uint32_t x[BLOCK_WORDS];
+        std::memcpy(x, in, sizeof(x));
+        for (int round = 0; round < 10; ++round) {
+            quarterRound(x[0], x[4], x[8], x[12]);
+            quarterRound(x[1], x[5], x[9], x[13]);
+            quarterRound(x[2], x[6], x[10], x[14]);
+            quarterRound(x[3], x[7], x[11], x[15]);
+            quarterRound(x[0], x[5], x[10], x[15]);
+            quarterRound(x[1], x[6], x[11], x[12]);
+            quarterRound(x[2], x[7], x[8], x[13]);
+            quarterRound(x[3], x[4], x[9], x[14]);
+        }
+        for (size_t i = 0; i < BLOCK_WORDS; ++i) {
+            out[i] = x[i] + in[i];
+        }
+    }
+
+private:
+    std::array<uint32_t, BLOCK_WORDS> state_;
+
+    void advance(uint64_t blocks) {
+        uint64_t counter = ((uint64_t) state_[13] << 32 | state_[12]) + blocks;
+        state_[12] = (uint32_t) counter;
+        state_[13] = (uint32_t) (counter >> 32);
+    }
+
+    static uint32_t rotl(uint32_t x, int n) {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    static void quarterRound(uint32_t &a, uint32_t &b, uint32_t &c, uint32_t &d) {
+        a += b;
+        d = rotl(d ^ a, 16);
+        c += d;
+        b = rotl(b ^ c, 12);
+        a += b;
+        d = rotl(d ^ a, 8);
+        c += d;
+        b = rotl(b ^ c, 7);
+    }
+
+#ifdef X86_DISPATCH
+
+    __attribute__((target("avx2")))
+    static void quarterRoundAvx2(__m256i &a, __m256i &b, __m256i &c, __m256i &d) {
+        const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                               2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+        const __m256i rot8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                              3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+        a = _mm256_add_epi32(a, b);
+        d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot16);
+        c = _mm256_add_epi32(c, d);
+        b = _mm256_xor_si256(b, c);
+        b = _mm256_or_si256(_mm256_slli_epi32(b, 12), _mm256_srli_epi32(b, 20));
+        a = _mm256_add_epi32(a, b);
+        d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rot8);
+        c = _mm256_add_epi32(c, d);
+        b = _mm256_xor_si256(b, c);
+        b = _mm256_or_si256(_mm256_slli_epi32(b, 7), _mm256_srli_epi32(b, 25));
+    }
+
+    // blocks with counters state, state + 1, ..., state + 7, register i holds word i of every block
+    __attribute__((target("avx2")))
+    static void blocksAvx2(const uint32_t *state, uint32_t *out) {
+        __m256i in[BLOCK_WORDS];
+        for (size_t i = 0; i < BLOCK_WORDS; ++i) {
+            in[i] = _mm256_set1_epi32((int) state[i]);
+        }
+        uint64_t counter = (uint64_t) state[13] << 32 | state[12];
+        alignas(32) uint32_t low[AVX2_BLOCKS], high[AVX2_BLOCKS];
+        for (size_t j = 0; j < AVX2_BLOCKS; ++j) {
+            low[j] = (uint32_t) (counter + j);
+            high[j] = (uint32_t) ((counter + j) >> 32);
+        }
+        in[12] = _mm256_load_si256((const __m256i *) low);
+        in[13] = _mm256_load_si256((const __m256i *) high);
+
+        __m256i x[BLOCK_WORDS];
+        std::copy(in, in + BLOCK_WORDS, x);
+        for (int round = 0; round < 10; ++round) {
+            quarterRoundAvx2(x[0], x[4], x[8], x[12]);
+            quarterRoundAvx2(x[1], x[5], x[9], x[13]);
+            quarterRoundAvx2(x[2], x[6], x[10], x[14]);
+            quarterRoundAvx2(x[3], x[7], x[11], x[15]);
+            quarterRoundAvx2(x[0], x[5], x[10], x[15]);
+            quarterRoundAvx2(x[1], x[6], x[11], x[12]);
+            quarterRoundAvx2(x[2], x[7], x[8], x[13]);
+            quarterRoundAvx2(x[3], x[4], x[9], x[14]);
+        }
+
+        // transpose back to block order
+        alignas(32) uint32_t words[BLOCK_WORDS][AVX2_BLOCKS];
+        for (size_t i = 0; i < BLOCK_WORDS; ++i) {
+            _mm256_store_si256((__m256i *) words[i], _mm256_add_epi32(x[i], in[i]));
+        }
+        for (size_t j = 0; j < AVX2_BLOCKS; ++j) {
+            for (size_t i = 0; i < BLOCK_WORDS; ++i) {
+                out[j * BLOCK_WORDS + i] = words[i][j];
+            }
+        }
+    }
+
+#endif
+};
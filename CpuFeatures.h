@@ -0,0 +1,29 @@
+#pragma once
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define X86_DISPATCH 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+// Vector kernels are compiled with target attributes and picked at run time, so the binary runs on any x86-64.
+#ifdef X86_DISPATCH
+
+inline bool hasAvx2() {
+    static const bool res = __builtin_cpu_supports("avx2");
+    return res;
+}
+
+// SHA extensions (CPUID leaf 7 EBX bit 29), the SHA-NI kernels also use SSE4.1
+inline bool hasShaNi() {
+    static const bool res = [] {
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (ebx >> 29 & 1) != 0 && __builtin_cpu_supports("sse4.1");
+    }();
+    return res;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include "BigInt.h"
+#include "ModularArithmetic.h"
+#include "Randomizer.h"
+#include "SafePrime.h"
+
+constexpr uint64_t ELGAMAL_Q_MAX = UINT64_MAX / 2 - 2;
+
+// RFC 3526 MODP groups: safe primes p = 2^n - 2^(n - 64) - 1 + 2^64 * (floor(2^(n - 130) * pi) + k), generator 2
+const char *const MODP_2048_MODULUS =
+        "0x"
+        "FFFFFFFF FFFFFFFF C90FDAA2 2168C234 C4C6628B 80DC1CD1 29024E08 8A67CC74"
+        "020BBEA6 3B139B22 514A0879 8E3404DD EF9519B3 CD3A431B 302B0A6D F25F1437"
+        "4FE1356D 6D51C245 E485B576 625E7EC6 F44C42E9 A637ED6B 0BFF5CB6 F406B7ED"
+        "EE386BFB 5A899FA5 AE9F2411 7C4B1FE6 49286651 ECE45B3D C2007CB8 A163BF05"
+        "98DA4836 1C55D39A 69163FA8 FD24CF5F 83655D23 DCA3AD96 1C62F356 208552BB"
+        "9ED52907 7096966D 670C354E 4ABC9804 F1746C08 CA18217C 32905E46 2E36CE3B"
+        "E39E772C 180E8603 9B2783A2 EC07A28F B5C55DF0 6F4C52C9 DE2BCBF6 95581718"
+        "3995497C EA956AE5 15D22618 98FA0510 15728E5A 8AACAA68 FFFFFFFF FFFFFFFF";
+const char *const MODP_3072_MODULUS =
+        "0x"
+        "FFFFFFFF FFFFFFFF C90FDAA2 2168C234 C4C6628B 80DC1CD1 29024E08 8A67CC74"
+        "020BBEA6 3B139B22 514A0879 8E3404DD EF9519B3 CD3A431B 302B0A6D F25F1437"
+        "4FE1356D 6D51C245 E485B576 625E7EC6 F44C42E9 A637ED6B 0BFF5CB6 F406B7ED"
+        "EE386BFB 5A899FA5 AE9F2411 7C4B1FE6 49286651 ECE45B3D C2007CB8 A163BF05"
+        "98DA4836 1C55D39A 69163FA8 FD24CF5F 83655D23 DCA3AD96 1C62F356 208552BB"
+        "9ED52907 7096966D 670C354E 4ABC9804 F1746C08 CA18217C 32905E46 2E36CE3B"
+        "E39E772C 180E8603 9B2783A2 EC07A28F B5C55DF0 6F4C52C9 DE2BCBF6 95581718"
+        "3995497C EA956AE5 15D22618 98FA0510 15728E5A 8AAAC42D AD33170D 04507A33"
+        "A85521AB DF1CBA64 ECFB8504 58DBEF0A 8AEA7157 5D060C7D B3970F85 A6E1E4C7"
+        "ABF5AE8C DB0933D7 1E8C94E0 4A25619D CEE3D226 1AD2EE6B F12FFA06 D98A0864"
+        "D8760273 3EC86A64 521F2B18 177B200C BBE11757 7A615D6C 770988C0 BAD946E2"
+        "08E24FA0 74E5AB31 43DB5BFC E0FD108E 4B82D120 A93AD2CA FFFFFFFF FFFFFFFF";
+const uint64_t MODP_BASE = 2;
+
+// T is uint64_t or BigInt; the base generates a subgroup of prime order (p - 1) / 2 or the whole group
+template<typename T>
+struct BasicElGamalParams {
+    T modulus;
+    T base;
+
+    // random 64-bit safe prime 2q + 1 with q at least min_prime_factor and a generator of the whole group
+    static BasicElGamalParams generate(Randomizer &randomizer, uint64_t min_prime_factor) {
+        static_assert(std::is_same<T, uint64_t>::value, "BigInt groups are fixed, use modpGroup");
+        BasicElGamalParams params;
+        uint64_t prime_factor = SafePrimeSearch().randomPrimeFactor(randomizer, min_prime_factor, ELGAMAL_Q_MAX);
+        params.modulus = 2 * prime_factor + 1;
+
+        BasicModularArithmetic<T> ma(params.modulus);
+        do {
+            params.base = randomizer.random(2, params.modulus - 2);
+        } while (ma.pow(params.base, prime_factor) == 1);
+
+        return params;
+    }
+
+    // the 2048 or 3072-bit RFC 3526 group, a safe prime that large takes far too long to search for
+    static BasicElGamalParams modpGroup(size_t bits) {
+        static_assert(std::is_same<T, BigInt>::value, "MODP groups do not fit into 64 bits");
+        if (bits != 2048 && bits != 3072) {
+            std::cerr << "There is no " << bits << "-bit MODP group, use 2048 or 3072" << std::endl;
+            exit(1);
+        }
+        BasicElGamalParams params;
+        params.modulus = BigInt::fromString(bits == 2048 ? MODP_2048_MODULUS : MODP_3072_MODULUS);
+        params.base = BigInt(MODP_BASE);
+
+        return params;
+    }
+
+    void print() {
+        std::cout << "modulus = " << modulus << std::endl;
+        std::cout << "base = " << base << std::endl;
+    }
+};
+
+using ElGamalParams = BasicElGamalParams<uint64_t>;
+
+// also a Diffie-Hellman key pair: the private exponent and base^private_key
+template<typename T>
+struct BasicElGamalKey {
+    T private_key;
+    T public_key;
+
+    static BasicElGamalKey generate(const BasicElGamalParams<T> &params, Randomizer &randomizer) {
+        BasicElGamalKey key;
+        BasicModularArithmetic<T> ma(params.modulus);
+
+        key.private_key = randomizer.random(T(2), params.modulus - T(2));
+        key.public_key = ma.pow(params.base, key.private_key);
+
+        return key;
+    }
+
+    void print() {
+        std::cout << "private key = " << private_key << std::endl;
+        std::cout << "public key = " << public_key << std::endl;
+    }
+};
+
+using ElGamalKey = BasicElGamalKey<uint64_t>;
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BigInt.h"
+#include "Field256.h"
+#include "Randomizer.h"
+
+// point in plain coordinates, as exchanged between parties
+struct AffinePoint {
+    Uint256 x = {};
+    Uint256 y = {};
+    bool infinity = false;
+
+    // SEC 1 compressed form: 02 or 03 by the parity of y, then x
+    std::string toHex() const {
+        if (infinity) {
+            return "00";
+        }
+        return std::string(y[0] & 1 ? "03" : "02") + ::toHex(x);
+    }
+};
+
+// (X / Z^2, Y / Z^3) with coordinates in Montgomery form, Z = 0 is the point at infinity
+struct JacobianPoint {
+    Uint256 x = {};
+    Uint256 y = {};
+    Uint256 z = {};
+};
+
+/*
+ * Short Weierstrass curve y^2 = x^3 + a * x + b over a prime field of at most 256 bits with a prime group order.
+ * Points are added in Jacobian coordinates, so only the conversion back to affine needs an inversion.
+ * Three scalar multiplications:
+ *   mulGenerator - table of d * 16^i * G, one masked lookup and one mixed addition per 4 bits, secret scalars
+ *   mul          - width-5 wNAF for a public scalar, e.g. verifying against a public key
+ *   mulLadder    - Montgomery ladder, the same add and double for every bit of a secret scalar
+ * Neither of the secret paths starts from infinity, so the special cases of add and dbl, which do branch,
+ * are only met by a handful of scalars such as 1, never by a random one.
+ */
+class EllipticCurve {
+public:
+    static constexpr unsigned WNAF_WIDTH = 5;
+    static constexpr unsigned FIXED_WINDOW = 4;
+    static constexpr unsigned FIXED_COLUMNS = 256 / FIXED_WINDOW;
+    static constexpr unsigned FIXED_DIGITS = (1u << FIXED_WINDOW) - 1; // nonzero digits per column
+
+    EllipticCurve(std::string name, const std::string &p, const std::string &a, const std::string &b,
+                  const std::string &gx, const std::string &gy, const std::string &n)
+            : name_(std::move(name)), field_(parse(p)), scalars_(parse(n)) {
+        a_ = field_.toMontgomery(parse(a));
+        b_ = field_.toMontgomery(parse(b));
+        a_is_minus_3_ = field_.add(a_, field_.toMontgomery(Uint256{3, 0, 0, 0})) == Uint256{};
+        generator_.x = parse(gx);
+        generator_.y = parse(gy);
+        buildGeneratorTable();
+    }
+
+    // NIST P-256 (secp256r1), the table for G is built on first use
+    static const EllipticCurve &p256() {
+        static const EllipticCurve curve(
+                "P-256",
+                "0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff",
+                "0xffffffff00000001000000000000000000000000fffffffffffffffffffffffc",
+                "0x5ac635d8aa3a93e7b3ebbd55769886bc651d06b0cc53b0f63bce3c3e27d2604b",
+                "0x6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296",
+                "0x4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5",
+                "0xffffffff00000000ffffffffffffffffbce6faada7179e84f3b9cac2fc632551");
+        return curve;
+    }
+
+    const std::string &name() const {
+        return name_;
+    }
+
+    const AffinePoint &generator() const {
+        return generator_;
+    }
+
+    const Uint256 &order() const {
+        return scalars_.modulus();
+    }
+
+    // arithmetic modulo the group order, for signatures
+    const Field256 &scalars() const {
+        return scalars_;
+    }
+
+    // uniform in [1, n - 1]
+    Uint256 randomScalar(Randomizer &randomizer) const {
+        Uint256 res;
+        size_t top_bits = bitLength(order()) % 64;
+        do {
+            for (uint64_t &limb: res) {
+                limb = randomizer.next();
+            }
+            if (top_bits != 0) {
+                res[3] &= ((uint64_t) 1 << top_bits) - 1;
+            }
+        } while (isZero(res) || !lessThan(res, order()));
+        return res;
+    }
+
+    bool isOnCurve(const AffinePoint &point) const {
+        if (point.infinity) {
+            return true;
+        }
+        if (!lessThan(point.x, field_.modulus()) || !lessThan(point.y, field_.modulus())) {
+            return false;
+        }
+        Uint256 x = field_.toMontgomery(point.x);
+        Uint256 y = field_.toMontgomery(point.y);
+        Uint256 rhs = field_.add(field_.mul(field_.add(field_.sqr(x), a_), x), b_); // (x^2 + a) * x + b
+        return field_.sqr(y) == rhs;
+    }
+
+    // starts from the offset 2^256 * G, which is taken off at the end; a zero digit adds a dummy and drops it
+    AffinePoint mulGenerator(const Uint256 &k) const {
+        JacobianPoint res = offset_;
+        for (unsigned i = 0; i < FIXED_COLUMNS; ++i) {
+            uint64_t digit = (k[i / 16] >> (FIXED_WINDOW * (i % 16))) & FIXED_DIGITS;
+            JacobianPoint entry{{}, {}, field_.one()};
+            for (uint64_t d = 1; d <= FIXED_DIGITS; ++d) {
+                uint64_t mask = 0 - (((d ^ digit) - 1) >> 63); // all ones for d == digit
+                const JacobianPoint &candidate = generator_table_[i * FIXED_DIGITS + d - 1];
+                entry.x = ::conditionalSelect(mask, candidate.x, entry.x);
+                entry.y = ::conditionalSelect(mask, candidate.y, entry.y);
+            }
+            res = conditionalSelect(0 - ((0 - digit) >> 63), addMixed(res, entry), res);
+        }
+        return toAffine(addMixed(res, negate(offset_)));
+    }
+
+    AffinePoint mul(const Uint256 &k, const AffinePoint &point) const {
+        return toAffine(mulJacobian(k, point));
+    }
+
+    // u1 * G + u2 * point, the ECDSA verification equation
+    AffinePoint mulAdd(const Uint256 &u1, const Uint256 &u2, const AffinePoint &point) const {
+        JacobianPoint res = mulJacobian(u2, point);
+        for (unsigned i = 0; i < FIXED_COLUMNS; ++i) {
+            unsigned digit = (u1[i / 16] >> (FIXED_WINDOW * (i % 16))) & FIXED_DIGITS;
+            if (digit != 0) {
+                res = addMixed(res, generator_table_[i * FIXED_DIGITS + digit - 1]);
+            }
+        }
+        return toAffine(res);
+    }
+
+    /*
+     * R0 = k' * P, R1 = (k' + 1) * P for the prefix k' of k + n or k + 2n, whichever has exactly 257 bits.
+     * Both give the same point, and the leading one lets the ladder start from P and 2P instead of infinity,
+     * so every k takes 256 identical steps. The swaps are masks, not branches.
+     */
+    AffinePoint mulLadder(const Uint256 &k, const AffinePoint &point) const {
+        Uint256 k_plus_n, k_plus_2n;
+        uint64_t carry = addCarry(k_plus_n, k, order());
+        addCarry(k_plus_2n, k_plus_n, order());
+        Uint256 low_bits = ::conditionalSelect(0 - carry, k_plus_n, k_plus_2n); // bit 256 is the implicit one
+
+        JacobianPoint r0 = toJacobian(point);
+        JacobianPoint r1 = dbl(r0);
+        for (size_t i = 256; i-- > 0;) {
+            uint64_t bit = (low_bits[i / 64] >> (i % 64)) & 1;
+            conditionalSwap(r0, r1, bit);
+            r1 = add(r0, r1);
+            r0 = dbl(r0);
+            conditionalSwap(r0, r1, bit);
+        }
+        return toAffine(r0);
+    }
+
+private:
+    std::string name_;
+    Field256 field_;
+    Field256 scalars_;
+    Uint256 a_;
+    Uint256 b_;
+    bool a_is_minus_3_;
+    AffinePoint generator_;
+    std::vector<JacobianPoint> generator_table_; // [i * FIXED_DIGITS + d - 1] = d * 16^i * G with Z = 1
+    JacobianPoint offset_; // 2^256 * G with Z = 1
+
+    static Uint256 parse(const std::string &hex) {
+        return toUint256(BigInt::fromString(hex));
+    }
+
+    JacobianPoint toJacobian(const AffinePoint &point) const {
+        if (point.infinity) {
+            return {};
+        }
+        return {field_.toMontgomery(point.x), field_.toMontgomery(point.y), field_.one()};
+    }
+
+    AffinePoint toAffine(const JacobianPoint &point) const {
+        AffinePoint res;
+        if (isZero(point.z)) {
+            res.infinity = true;
+            return res;
+        }
+        Uint256 z_inv = field_.inv(point.z);
+        Uint256 z_inv2 = field_.sqr(z_inv);
+        res.x = field_.fromMontgomery(field_.mul(point.x, z_inv2));
+        res.y = field_.fromMontgomery(field_.mul(point.y, field_.mul(z_inv2, z_inv)));
+        return res;
+    }
+
+    Uint256 twice(const Uint256 &a) const {
+        return field_.add(a, a);
+    }
+
+    // dbl-2007-bl, with 3 * (X - Z^2) * (X + Z^2) for a = -3
+    JacobianPoint dbl(const JacobianPoint &p) const {
+        Uint256 xx = field_.sqr(p.x);
+        Uint256 yy = field_.sqr(p.y);
+        Uint256 yyyy = field_.sqr(yy);
+        Uint256 zz = field_.sqr(p.z);
+        Uint256 s = twice(field_.sub(field_.sub(field_.sqr(field_.add(p.x, yy)), xx), yyyy));
+        Uint256 m;
+        if (a_is_minus_3_) {
+            m = field_.mul(field_.sub(p.x, zz), field_.add(p.x, zz));
+            m = field_.add(twice(m), m);
+        } else {
+            m = field_.add(field_.add(twice(xx), xx), field_.mul(a_, field_.sqr(zz)));
+        }
+
+        JacobianPoint res;
+        res.x = field_.sub(field_.sqr(m), twice(s));
+        res.y = field_.sub(field_.mul(m, field_.sub(s, res.x)), twice(twice(twice(yyyy))));
+        res.z = field_.sub(field_.sub(field_.sqr(field_.add(p.y, p.z)), yy), zz);
+        return res;
+    }
+
+    // add-2007-bl
+    JacobianPoint add(const JacobianPoint &p, const JacobianPoint &q) const {
+        if (isZero(p.z)) {
+            return q;
+        }
+        if (isZero(q.z)) {
+            return p;
+        }
+        Uint256 z1z1 = field_.sqr(p.z);
+        Uint256 z2z2 = field_.sqr(q.z);
+        Uint256 u1 = field_.mul(p.x, z2z2);
+        Uint256 u2 = field_.mul(q.x, z1z1);
+        Uint256 s1 = field_.mul(p.y, field_.mul(q.z, z2z2));
+        Uint256 s2 = field_.mul(q.y, field_.mul(p.z, z1z1));
+        Uint256 h = field_.sub(u2, u1);
+        Uint256 r = twice(field_.sub(s2, s1));
+        if (isZero(h)) {
+            return isZero(r) ? dbl(p) : JacobianPoint{};
+        }
+        Uint256 i = field_.sqr(twice(h));
+        Uint256 j = field_.mul(h, i);
+        Uint256 v = field_.mul(u1, i);
+
+        JacobianPoint res;
+        res.x = field_.sub(field_.sub(field_.sqr(r), j), twice(v));
+        res.y = field_.sub(field_.mul(r, field_.sub(v, res.x)), twice(field_.mul(s1, j)));
+        res.z = field_.mul(field_.sub(field_.sub(field_.sqr(field_.add(p.z, q.z)), z1z1), z2z2), h);
+        return res;
+    }
+
+    // madd-2007-bl, q has Z = 1
+    JacobianPoint addMixed(const JacobianPoint &p, const JacobianPoint &q) const {
+        if (isZero(p.z)) {
+            return q;
+        }
+        Uint256 z1z1 = field_.sqr(p.z);
+        Uint256 u2 = field_.mul(q.x, z1z1);
+        Uint256 s2 = field_.mul(q.y, field_.mul(p.z, z1z1));
+        Uint256 h = field_.sub(u2, p.x);
+        Uint256 r = twice(field_.sub(s2, p.y));
+        if (isZero(h)) {
+            return isZero(r) ? dbl(p) : JacobianPoint{};
+        }
+        Uint256 hh = field_.sqr(h);
+        Uint256 i = twice(twice(hh));
+        Uint256 j = field_.mul(h, i);
+        Uint256 v = field_.mul(p.x, i);
+
+        JacobianPoint res;
+        res.x = field_.sub(field_.sub(field_.sqr(r), j), twice(v));
+        res.y = field_.sub(field_.mul(r, field_.sub(v, res.x)), twice(field_.mul(p.y, j)));
+        res.z = field_.sub(field_.sub(field_.sqr(field_.add(p.z, h)), z1z1), hh);
+        return res;
+    }
+
+    JacobianPoint negate(const JacobianPoint &p) const {
+        return {p.x, field_.neg(p.y), p.z};
+    }
+
+    static JacobianPoint conditionalSelect(uint64_t mask, const JacobianPoint &p, const JacobianPoint &q) {
+        return {::conditionalSelect(mask, p.x, q.x), ::conditionalSelect(mask, p.y, q.y),
+                ::conditionalSelect(mask, p.z, q.z)};
+    }
+
+    static void conditionalSwap(JacobianPoint &p, JacobianPoint &q, uint64_t bit) {
+        uint64_t mask = 0 - bit;
+        for (size_t i = 0; i < 4; ++i) {
+            uint64_t t = mask & (p.x[i] ^ q.x[i]);
+            p.x[i] ^= t;
+            q.x[i] ^= t;
+            t = mask & (p.y[i] ^ q.y[i]);
+            p.y[i] ^= t;
+            q.y[i] ^= t;
+            t = mask & (p.z[i] ^ q.z[i]);
+            p.z[i] ^= t;
+            q.z[i] ^= t;
+        }
+    }
+
+    // signed digits in (-2^(w-1), 2^(w-1)), odd or zero, at least w - 1 zeros after each nonzero one
+    static std::vector<int> wnaf(const Uint256 &k) {
+        std::vector<int> res(257, 0);
+        unsigned carry = 0;
+        for (size_t bit = 0; bit < res.size();) {
+            if (testBit(k, bit) == (carry == 1)) {
+                ++bit;
+                continue;
+            }
+            unsigned word = carry;
+            for (unsigned j = 0; j < WNAF_WIDTH; ++j) {
+                word += (unsigned) testBit(k, bit + j) << j;
+            }
+            carry = (word >> (WNAF_WIDTH - 1)) & 1;
+            res[bit] = (int) word - (int) (carry << WNAF_WIDTH);
+            bit += WNAF_WIDTH;
+        }
+        return res;
+    }
+
+    JacobianPoint mulJacobian(const Uint256 &k, const AffinePoint &point) const {
+        // odd multiples P, 3P, ..., (2^(w-1) - 1) * P
+        std::vector<JacobianPoint> odd_multiples(size_t(1) << (WNAF_WIDTH - 2));
+        odd_multiples[0] = toJacobian(point);
+        JacobianPoint point_twice = dbl(odd_multiples[0]);
+        for (size_t i = 1; i < odd_multiples.size(); ++i) {
+            odd_multiples[i] = add(odd_multiples[i - 1], point_twice);
+        }
+
+        std::vector<int> digits = wnaf(k);
+        JacobianPoint res;
+        for (size_t i = digits.size(); i-- > 0;) {
+            res = dbl(res);
+            if (digits[i] > 0) {
+                res = add(res, odd_multiples[digits[i] / 2]);
+            } else if (digits[i] < 0) {
+                res = add(res, negate(odd_multiples[-digits[i] / 2]));
+            }
+        }
+        return res;
+    }
+
+    // every d * 16^i * G, brought to Z = 1 with one shared inversion (Montgomery's trick)
+    void buildGeneratorTable() {
+        generator_table_.resize(FIXED_COLUMNS * FIXED_DIGITS);
+        JacobianPoint column_base = toJacobian(generator_);
+        for (unsigned i = 0; i < FIXED_COLUMNS; ++i) {
+            JacobianPoint *column = &generator_table_[i * FIXED_DIGITS];
+            column[0] = column_base;
+            for (unsigned d = 1; d < FIXED_DIGITS; ++d) {
+                column[d] = add(column[d - 1], column_base);
+            }
+            column_base = add(column[FIXED_DIGITS - 1], column_base);
+        }
+        offset_ = toJacobian(toAffine(column_base));
+
+        std::vector<Uint256> prefix(generator_table_.size());
+        Uint256 product = field_.one();
+        for (size_t i = 0; i < generator_table_.size(); ++i) {
+            prefix[i] = product;
+            product = field_.mul(product, generator_table_[i].z);
+        }
+        Uint256 inverse = field_.inv(product);
+        for (size_t i = generator_table_.size(); i-- > 0;) {
+            JacobianPoint &point = generator_table_[i];
+            Uint256 z_inv = field_.mul(inverse, prefix[i]);
+            inverse = field_.mul(inverse, point.z);
+            Uint256 z_inv2 = field_.sqr(z_inv);
+            point.x = field_.mul(point.x, z_inv2);
+            point.y = field_.mul(point.y, field_.mul(z_inv2, z_inv));
+            point.z = field_.one();
+        }
+    }
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+inline size_t bitLength(uint64_t x) {
+    return x == 0 ? 0 : 64 - __builtin_clzll(x);
+}
+
+inline bool testBit(uint64_t x, size_t i) {
+    return i < 64 && ((x >> i) & 1);
+}
+
+// window width for an exponent of the given bit length, trades table size for fewer multiplications
+inline size_t slidingWindowSize(size_t exponent_bits) {
+    if (exponent_bits > 671) return 6;
+    if (exponent_bits > 239) return 5;
+    if (exponent_bits > 79) return 4;
+    if (exponent_bits > 23) return 3;
+    if (exponent_bits > 6) return 2;
+    return 1;
+}
+
+/*
+ * Left-to-right sliding window exponentiation.
+ * Field provides Element, one(), mul(a, b) and sqr(a); Exponent needs bitLength() and testBit() overloads.
+ * Only odd powers base^1, base^3, ..., base^(2^w - 1) are precomputed, windows always end with a set bit.
+ */
+template<typename Field, typename Exponent>
+typename Field::Element slidingWindowPow(const Field &field, const typename Field::Element &base,
+                                         const Exponent &exponent) {
+    using Element = typename Field::Element;
+
+    size_t bits = bitLength(exponent);
+    if (bits == 0) {
+        return field.one();
+    }
+
+    size_t window = slidingWindowSize(bits);
+    std::vector<Element> odd_powers(size_t(1) << (window - 1));
+    odd_powers[0] = base;
+    if (odd_powers.size() > 1) {
+        Element base_sqr = field.sqr(base);
+        for (size_t k = 1; k < odd_powers.size(); ++k) {
+            odd_powers[k] = field.mul(odd_powers[k - 1], base_sqr);
+        }
+    }
+
+    Element res = field.one();
+    bool started = false;
+    size_t i = bits; // number of bits still to process, the next one is i - 1
+    while (i > 0) {
+        if (!testBit(exponent, i - 1)) {
+            if (started) {
+                res = field.sqr(res);
+            }
+            --i;
+            continue;
+        }
+
+        // the window covers bits [low, i - 1], shrunk so that its lowest bit is set
+        size_t low = i > window ? i - window : 0;
+        while (!testBit(exponent, low)) {
+            ++low;
+        }
+
+        size_t value = 0;
+        for (size_t k = i; k > low; --k) {
+            value = (value << 1) | (testBit(exponent, k - 1) ? 1 : 0);
+            if (started) {
+                res = field.sqr(res);
+            }
+        }
+
+        res = started ? field.mul(res, odd_powers[value >> 1]) : odd_powers[value >> 1];
+        started = true;
+        i = low;
+    }
+
+    return res;
+}
+
+// bases per joint table and window width for count exponents of the given bit length:
+// minimizes table entries plus window multiplications, the squarings are shared by all groups anyway
+inline void multiPowShape(size_t count, size_t exponent_bits, size_t &group_size, size_t &window) {
+    double best_cost = -1;
+    for (size_t group = 1; group <= std::min<size_t>(count, 8); ++group) {
+        for (size_t width = 1; width * group <= 12; ++width) {
+            double groups = (double) ((count + group - 1) / group);
+            double entries = (double) (size_t(1) << (width * group));
+            double columns = (double) ((exponent_bits + width - 1) / width);
+            double cost = groups * (entries - (double) group - 1 + columns * (1 - 1 / entries));
+            if (best_cost < 0 || cost < best_cost) {
+                group_size = group;
+                window = width;
+                best_cost = cost;
+            }
+        }
+    }
+}
+
+/*
+ * Product of bases[j]^exponents[j] with one shared squaring chain (Straus / Shamir's trick).
+ * Bases are split into groups, each with a joint table of every product of its base powers below 2^w,
+ * entry index = sum of digit_j << (w * j). Each w-bit column of the exponents costs w squarings
+ * and at most one multiplication per group.
+ */
+template<typename Field, typename Exponent>
+typename Field::Element multiPow(const Field &field, const std::vector<typename Field::Element> &bases,
+                                 const std::vector<Exponent> &exponents) {
+    using Element = typename Field::Element;
+
+    size_t count = bases.size();
+    size_t bits = 0;
+    for (const Exponent &exponent: exponents) {
+        bits = std::max(bits, (size_t) bitLength(exponent));
+    }
+    if (bits == 0) {
+        return field.one();
+    }
+    if (count == 1) {
+        return slidingWindowPow(field, bases[0], exponents[0]);
+    }
+
+    size_t group_size = 1, window = 1;
+    multiPowShape(count, bits, group_size, window);
+    size_t digits = size_t(1) << window;
+    size_t groups = (count + group_size - 1) / group_size;
+    std::vector<std::vector<Element>> tables(groups);
+    for (size_t g = 0; g < groups; ++g) {
+        size_t first = g * group_size;
+        size_t size = std::min(group_size, count - first);
+        std::vector<Element> &table = tables[g];
+        table.resize(size_t(1) << (window * size));
+        table[0] = field.one();
+        size_t filled = 1; // entries using only the first j bases of the group
+        for (size_t j = 0; j < size; ++j) {
+            for (size_t digit = 1; digit < digits; ++digit) {
+                for (size_t index = 0; index < filled; ++index) {
+                    size_t previous = index + ((digit - 1) << (window * j));
+                    table[index + (digit << (window * j))] = digit == 1 && index == 0
+                                                             ? bases[first + j]
+                                                             : field.mul(table[previous], bases[first + j]);
+                }
+            }
+            filled <<= window;
+        }
+    }
+
+    Element res = field.one();
+    bool started = false;
+    for (size_t column = (bits + window - 1) / window; column-- > 0;) {
+        if (started) {
+            for (size_t t = 0; t < window; ++t) {
+                res = field.sqr(res);
+            }
+        }
+        for (size_t g = 0; g < groups; ++g) {
+            size_t index = 0;
+            for (size_t j = g * group_size; j < std::min(count, (g + 1) * group_size); ++j) {
+                size_t digit = 0;
+                for (size_t t = window; t-- > 0;) {
+                    digit = (digit << 1) | (testBit(exponents[j], column * window + t) ? 1 : 0);
+                }
+                index |= digit << (window * (j - g * group_size));
+            }
+            if (index != 0) {
+                res = started ? field.mul(res, tables[g][index]) : tables[g][index];
+                started = true;
+            }
+        }
+    }
+
+    return res;
+}
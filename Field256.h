@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include "BigInt.h"
+#include "Exponentiation.h"
+
+// 256-bit unsigned integer, little-endian 64-bit limbs; fixed width, so it lives on the stack unlike BigInt
+struct Uint256 {
+    uint64_t limbs[4];
+
+    uint64_t &operator[](size_t i) {
+        return limbs[i];
+    }
+
+    const uint64_t &operator[](size_t i) const {
+        return limbs[i];
+    }
+
+    uint64_t *begin() {
+        return limbs;
+    }
+
+    uint64_t *end() {
+        return limbs + 4;
+    }
+
+    friend bool operator==(const Uint256 &a, const Uint256 &b) {
+        return ((a[0] ^ b[0]) | (a[1] ^ b[1]) | (a[2] ^ b[2]) | (a[3] ^ b[3])) == 0;
+    }
+
+    friend bool operator!=(const Uint256 &a, const Uint256 &b) {
+        return !(a == b);
+    }
+};
+
+inline Uint256 toUint256(const BigInt &x) {
+    assert(x.bitLength() <= 256);
+    return {x.limb(0), x.limb(1), x.limb(2), x.limb(3)};
+}
+
+inline BigInt toBigInt(const Uint256 &x) {
+    return BigInt::fromLimbs({x[0], x[1], x[2], x[3]});
+}
+
+inline size_t bitLength(const Uint256 &x) {
+    for (size_t i = 4; i-- > 0;) {
+        if (x[i] != 0) {
+            return i * 64 + bitLength(x[i]);
+        }
+    }
+    return 0;
+}
+
+inline bool testBit(const Uint256 &x, size_t i) {
+    return i < 256 && ((x[i / 64] >> (i % 64)) & 1);
+}
+
+inline bool isZero(const Uint256 &x) {
+    return (x[0] | x[1] | x[2] | x[3]) == 0;
+}
+
+inline bool lessThan(const Uint256 &a, const Uint256 &b) {
+    for (size_t i = 4; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i];
+        }
+    }
+    return false;
+}
+
+// res = a + b, returns the carry out of the top limb
+inline uint64_t addCarry(Uint256 &res, const Uint256 &a, const Uint256 &b) {
+    unsigned __int128 carry = 0;
+    #pragma GCC unroll 4
+    for (size_t i = 0; i < 4; ++i) {
+        carry += (unsigned __int128) a[i] + b[i];
+        res[i] = (uint64_t) carry;
+        carry >>= 64;
+    }
+    return (uint64_t) carry;
+}
+
+// res = a - b, returns the borrow out of the top limb
+inline uint64_t subBorrow(Uint256 &res, const Uint256 &a, const Uint256 &b) {
+    uint64_t borrow = 0;
+    #pragma GCC unroll 4
+    for (size_t i = 0; i < 4; ++i) {
+        unsigned __int128 diff = (unsigned __int128) a[i] - b[i] - borrow;
+        res[i] = (uint64_t) diff;
+        borrow = (uint64_t) (diff >> 64) & 1;
+    }
+    return borrow;
+}
+
+// a where mask is all ones, b where it is zero, without branching on either
+inline Uint256 conditionalSelect(uint64_t mask, const Uint256 &a, const Uint256 &b) {
+    return {(a[0] & mask) | (b[0] & ~mask), (a[1] & mask) | (b[1] & ~mask),
+            (a[2] & mask) | (b[2] & ~mask), (a[3] & mask) | (b[3] & ~mask)};
+}
+
+// 64 hex digits, most significant first
+inline std::string toHex(const Uint256 &x) {
+    static const char digits[] = "0123456789abcdef";
+    std::string res(64, '0');
+    for (size_t i = 0; i < 64; ++i) {
+        res[63 - i] = digits[(x[i / 16] >> (4 * (i % 16))) & 0xf];
+    }
+    return res;
+}
+
+/*
+ * Arithmetic modulo an odd n < 2^256 in Montgomery form with R = 2^256, the same CIOS product as
+ * MontgomeryContext<BigInt> but unrolled over four limbs on the stack. Elements are always fully reduced.
+ * Provides the Field interface of Exponentiation.h, so inversion is a sliding window pow by n - 2 (n prime).
+ * The final subtractions are masked, so add, sub and mul take the same path for every secret operand.
+ */
+class Field256 {
+public:
+    using Element = Uint256;
+
+    explicit Field256(const Uint256 &modulus) : modulus_(modulus) {
+        assert((modulus_[0] & 1) && bitLength(modulus_) > 1);
+
+        uint64_t n0_inv = modulus_[0];
+        for (int i = 0; i < 5; ++i) {
+            n0_inv *= 2 - modulus_[0] * n0_inv;
+        }
+        n0_neg_inv_ = 0 - n0_inv;
+
+        BigInt n = toBigInt(modulus_);
+        one_ = toUint256(BigInt::powerOfTwo(256) % n);
+        r2_ = toUint256(BigInt::powerOfTwo(512) % n);
+    }
+
+    const Uint256 &modulus() const {
+        return modulus_;
+    }
+
+    // Montgomery form of 1
+    const Uint256 &one() const {
+        return one_;
+    }
+
+    // any 256-bit value, reduced mod n first
+    Uint256 toMontgomery(const Uint256 &a) const {
+        return mul(reduce(a), r2_);
+    }
+
+    Uint256 fromMontgomery(const Uint256 &a) const {
+        return mul(a, Uint256{1, 0, 0, 0});
+    }
+
+    // a mod n for any 256-bit a
+    Uint256 reduce(const Uint256 &a) const {
+        if (lessThan(a, modulus_)) {
+            return a;
+        }
+        return toUint256(toBigInt(a) % toBigInt(modulus_));
+    }
+
+    Uint256 add(const Uint256 &a, const Uint256 &b) const {
+        Uint256 res, reduced;
+        uint64_t carry = addCarry(res, a, b);
+        uint64_t borrow = subBorrow(reduced, res, modulus_);
+        return conditionalSelect(0 - (carry | (borrow ^ 1)), reduced, res);
+    }
+
+    Uint256 sub(const Uint256 &a, const Uint256 &b) const {
+        Uint256 res;
+        uint64_t borrow = subBorrow(res, a, b);
+        addCarry(res, res, conditionalSelect(0 - borrow, modulus_, Uint256{}));
+        return res;
+    }
+
+    Uint256 neg(const Uint256 &a) const {
+        return sub(Uint256{}, a);
+    }
+
+    // a * b * R^-1 mod n
+    Uint256 mul(const Uint256 &a, const Uint256 &b) const {
+        uint64_t t[6] = {0, 0, 0, 0, 0, 0};
+        #pragma GCC unroll 4
+        for (size_t i = 0; i < 4; ++i) {
+            uint64_t carry = 0;
+            #pragma GCC unroll 4
+            for (size_t j = 0; j < 4; ++j) {
+                unsigned __int128 cur = (unsigned __int128) a[i] * b[j] + t[j] + carry;
+                t[j] = (uint64_t) cur;
+                carry = (uint64_t) (cur >> 64);
+            }
+            unsigned __int128 top = (unsigned __int128) t[4] + carry;
+            t[4] = (uint64_t) top;
+            t[5] = (uint64_t) (top >> 64);
+
+            // add m * n so that the lowest limb becomes zero, then drop it
+            uint64_t m = t[0] * n0_neg_inv_;
+            unsigned __int128 cur = (unsigned __int128) m * modulus_[0] + t[0];
+            carry = (uint64_t) (cur >> 64);
+            #pragma GCC unroll 4
+            for (size_t j = 1; j < 4; ++j) {
+                cur = (unsigned __int128) m * modulus_[j] + t[j] + carry;
+                t[j - 1] = (uint64_t) cur;
+                carry = (uint64_t) (cur >> 64);
+            }
+            top = (unsigned __int128) t[4] + carry;
+            t[3] = (uint64_t) top;
+            t[4] = t[5] + (uint64_t) (top >> 64);
+        }
+
+        Uint256 res = {t[0], t[1], t[2], t[3]}, reduced;
+        uint64_t borrow = subBorrow(reduced, res, modulus_);
+        return conditionalSelect(0 - (t[4] | (borrow ^ 1)), reduced, res);
+    }
+
+    Uint256 sqr(const Uint256 &a) const {
+        return mul(a, a);
+    }
+
+    // a^-1 for a prime modulus, zero stays zero
+    Uint256 inv(const Uint256 &a) const {
+        Uint256 exponent;
+        subBorrow(exponent, modulus_, Uint256{2, 0, 0, 0});
+        return slidingWindowPow(*this, a, exponent);
+    }
+
+private:
+    Uint256 modulus_;
+    uint64_t n0_neg_inv_;
+    Uint256 one_;
+    Uint256 r2_;
+};
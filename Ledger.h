@@ -0,0 +1,346 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "functions.h"
+
+// One ledger change, 32 bytes on disk. A record whose checksum does not match ends the log (torn write).
+struct LedgerRecord {
+    enum Type : uint32_t {
+        CREATE = 1, // account gets balance amount
+        WITHDRAW = 2, // amount leaves the account
+        DEPOSIT = 3, // amount enters the account and note becomes spent
+    };
+
+    uint32_t type;
+    uint32_t checksum;
+    uint64_t account;
+    uint64_t amount;
+    uint64_t note;
+
+    uint32_t computeChecksum() const {
+        return (uint32_t) mixHash(mixHash(mixHash(((uint64_t) type << 32) ^ account) ^ amount) ^ note);
+    }
+};
+
+static_assert(sizeof(LedgerRecord) == 32, "LedgerRecord is written to disk as is");
+
+struct LedgerState {
+    std::vector<uint64_t> balances;
+    std::vector<uint64_t> spent_notes;
+
+    void apply(const LedgerRecord &record) {
+        if (record.account >= balances.size()) {
+            balances.resize(record.account + 1, 0);
+        }
+        // withdrawals and deposits commute, so records of different threads may come in any order
+        switch (record.type) {
+            case LedgerRecord::CREATE:
+                balances[record.account] = record.amount;
+                break;
+            case LedgerRecord::WITHDRAW:
+                balances[record.account] -= record.amount;
+                break;
+            case LedgerRecord::DEPOSIT:
+                balances[record.account] += record.amount;
+                spent_notes.push_back(record.note);
+                break;
+        }
+    }
+};
+
+/*
+ * Write-ahead log of ledger changes in a directory: snapshot plus wal.<generation> files.
+ * A change is applied in memory and appended under guard(), then commit() waits until it is on disk.
+ * Commits of concurrent threads share one write + fdatasync: the first waiter flushes everything buffered
+ * so far and the others wait for it (group commit).
+ * Every snapshot_interval records the log moves to a new generation and the state is written to a snapshot
+ * covering all older generations, so startup reads the snapshot and replays only the newer logs.
+ */
+class Ledger {
+public:
+    Ledger(const std::string &dir, uint64_t snapshot_interval)
+            : dir_(dir), snapshot_interval_(snapshot_interval) {
+        std::error_code error;
+        std::filesystem::create_directories(dir_, error);
+        if (error) {
+            fail("cannot create " + dir_.string());
+        }
+    }
+
+    ~Ledger() {
+        if (fd_ >= 0) {
+            sync(appended_seq_);
+            close(fd_);
+        }
+    }
+
+    Ledger(const Ledger &) = delete;
+    Ledger &operator=(const Ledger &) = delete;
+
+    // loads the snapshot and replays newer logs, must be called once before anything is appended
+    LedgerState recover() {
+        LedgerState state;
+        uint64_t generation = readSnapshot(state);
+
+        std::vector<uint64_t> logs;
+        for (const auto &entry: std::filesystem::directory_iterator(dir_)) {
+            std::string name = entry.path().filename().string();
+            if (name.rfind("wal.", 0) == 0) {
+                logs.push_back(std::stoull(name.substr(4)));
+            }
+        }
+        std::sort(logs.begin(), logs.end());
+
+        for (uint64_t log: logs) {
+            if (log < generation) {
+                std::filesystem::remove(logPath(log)); // left over from a snapshot interrupted before cleanup
+                continue;
+            }
+            recovered_records_ += replayLog(log, state);
+        }
+
+        generation_ = logs.empty() ? generation : std::max(generation, logs.back() + 1);
+        openLog();
+        return state;
+    }
+
+    uint64_t recoveredRecords() const {
+        return recovered_records_;
+    }
+
+    // held while a change is applied in memory and appended, so a snapshot never sees half of it
+    std::shared_lock<std::shared_mutex> guard() {
+        return std::shared_lock<std::shared_mutex>(checkpoint_mutex_);
+    }
+
+    // buffers the record and returns its sequence number for commit()
+    uint64_t append(LedgerRecord record) {
+        record.checksum = record.computeChecksum();
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffer_.push_back(record);
+        ++records_since_snapshot_;
+        return ++appended_seq_;
+    }
+
+    // returns once the record with sequence number seq is durable
+    void commit(uint64_t seq) {
+        sync(seq);
+    }
+
+    bool snapshotDue() const {
+        return snapshot_interval_ != 0 && records_since_snapshot_.load(std::memory_order_relaxed) >= snapshot_interval_;
+    }
+
+    // capture() returns the in-memory state, it runs while no change is in flight; one snapshot at a time
+    template<typename Capture>
+    void snapshot(Capture capture) {
+        std::unique_lock<std::mutex> snapshot_lock(snapshot_mutex_, std::try_to_lock);
+        if (!snapshot_lock.owns_lock()) {
+            return;
+        }
+
+        LedgerState state;
+        uint64_t generation;
+        {
+            std::unique_lock<std::shared_mutex> checkpoint_lock(checkpoint_mutex_);
+            if (!snapshotDue()) {
+                return; // another thread has just taken it
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            flushLocked(lock, appended_seq_);
+            close(fd_);
+            ++generation_;
+            openLog();
+            generation = generation_;
+            records_since_snapshot_ = 0;
+            lock.unlock();
+            state = capture();
+        }
+
+        // changes go to the new log meanwhile, until the rename the old snapshot and logs stay valid
+        writeSnapshot(state, generation);
+        for (const auto &entry: std::filesystem::directory_iterator(dir_)) {
+            std::string name = entry.path().filename().string();
+            if (name.rfind("wal.", 0) == 0 && std::stoull(name.substr(4)) < generation) {
+                std::filesystem::remove(entry.path());
+            }
+        }
+    }
+
+private:
+    static constexpr uint64_t SNAPSHOT_MAGIC = 0x31504e534744454c; // "LEDGSNP1"
+
+    std::filesystem::path dir_;
+    uint64_t snapshot_interval_;
+    uint64_t generation_ = 0;
+    uint64_t recovered_records_ = 0;
+    int fd_ = -1;
+
+    std::shared_mutex checkpoint_mutex_;
+    std::mutex snapshot_mutex_;
+
+    std::mutex mutex_; // guards everything below
+    std::condition_variable flushed_;
+    std::vector<LedgerRecord> buffer_;
+    uint64_t appended_seq_ = 0;
+    uint64_t durable_seq_ = 0;
+    bool flushing_ = false;
+    std::atomic<uint64_t> records_since_snapshot_{0};
+
+    static void fail(const std::string &message) {
+        std::cerr << "Ledger: " << message << std::endl;
+        exit(1);
+    }
+
+    std::filesystem::path logPath(uint64_t generation) const {
+        return dir_ / ("wal." + std::to_string(generation));
+    }
+
+    void sync(uint64_t seq) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        flushLocked(lock, seq);
+    }
+
+    // the caller holds lock on mutex_, it is released around the write so that others keep appending
+    void flushLocked(std::unique_lock<std::mutex> &lock, uint64_t seq) {
+        while (durable_seq_ < seq) {
+            if (flushing_) {
+                flushed_.wait(lock);
+                continue;
+            }
+            flushing_ = true;
+            std::vector<LedgerRecord> records;
+            records.swap(buffer_);
+            uint64_t batch_seq = appended_seq_;
+            lock.unlock();
+
+            writeAll(fd_, records.data(), records.size() * sizeof(LedgerRecord));
+            if (fdatasync(fd_) != 0) {
+                fail("fdatasync failed");
+            }
+
+            lock.lock();
+            durable_seq_ = batch_seq;
+            flushing_ = false;
+            flushed_.notify_all();
+        }
+    }
+
+    static void writeAll(int fd, const void *data, size_t size) {
+        const char *ptr = (const char *) data;
+        while (size > 0) {
+            ssize_t written = write(fd, ptr, size);
+            if (written < 0) {
+                fail("write failed");
+            }
+            ptr += written;
+            size -= written;
+        }
+    }
+
+    // makes creations and renames inside the directory durable
+    void syncDir() const {
+        int dir_fd = open(dir_.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dir_fd < 0 || fsync(dir_fd) != 0) {
+            fail("cannot sync " + dir_.string());
+        }
+        close(dir_fd);
+    }
+
+    void openLog() {
+        fd_ = open(logPath(generation_).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd_ < 0) {
+            fail("cannot open " + logPath(generation_).string());
+        }
+        syncDir();
+    }
+
+    // records up to the first torn one are applied and the torn tail is cut off
+    uint64_t replayLog(uint64_t generation, LedgerState &state) const {
+        std::filesystem::path path = logPath(generation);
+        std::ifstream file(path, std::ios::binary);
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        uint64_t count = 0;
+        for (size_t offset = 0; offset + sizeof(LedgerRecord) <= data.size(); offset += sizeof(LedgerRecord)) {
+            LedgerRecord record;
+            std::copy(data.begin() + offset, data.begin() + offset + sizeof(LedgerRecord), (char *) &record);
+            if (record.checksum != record.computeChecksum()) {
+                break;
+            }
+            state.apply(record);
+            ++count;
+        }
+        if (count * sizeof(LedgerRecord) != data.size()) {
+            std::filesystem::resize_file(path, count * sizeof(LedgerRecord));
+        }
+        return count;
+    }
+
+    // words: magic, generation, account count, balances, note count, notes, checksum of everything before it
+    void writeSnapshot(const LedgerState &state, uint64_t generation) const {
+        std::vector<uint64_t> words = {SNAPSHOT_MAGIC, generation, state.balances.size()};
+        words.insert(words.end(), state.balances.begin(), state.balances.end());
+        words.push_back(state.spent_notes.size());
+        words.insert(words.end(), state.spent_notes.begin(), state.spent_notes.end());
+        words.push_back(snapshotChecksum(words));
+
+        std::filesystem::path tmp_path = dir_ / "snapshot.tmp";
+        int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            fail("cannot open " + tmp_path.string());
+        }
+        writeAll(fd, words.data(), words.size() * sizeof(uint64_t));
+        if (fsync(fd) != 0) {
+            fail("fsync failed");
+        }
+        close(fd);
+        std::filesystem::rename(tmp_path, dir_ / "snapshot");
+        syncDir();
+    }
+
+    // generation the snapshot covers, 0 without a snapshot
+    uint64_t readSnapshot(LedgerState &state) const {
+        std::ifstream file(dir_ / "snapshot", std::ios::binary);
+        if (!file) {
+            return 0;
+        }
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::vector<uint64_t> words(data.size() / sizeof(uint64_t));
+        std::copy(data.begin(), data.begin() + words.size() * sizeof(uint64_t), (char *) words.data());
+
+        // the snapshot is renamed into place only when complete, so a bad one is not a torn write
+        if (words.size() < 5 || words[0] != SNAPSHOT_MAGIC
+            || words.back() != snapshotChecksum({words.begin(), words.end() - 1})) {
+            fail("snapshot in " + dir_.string() + " is corrupted");
+        }
+        uint64_t accounts = words[2];
+        if (3 + accounts + 1 >= words.size() || words[3 + accounts] != words.size() - 5 - accounts) {
+            fail("snapshot in " + dir_.string() + " is corrupted");
+        }
+        state.balances.assign(words.begin() + 3, words.begin() + 3 + accounts);
+        state.spent_notes.assign(words.begin() + 4 + accounts, words.end() - 1);
+        return words[1];
+    }
+
+    static uint64_t snapshotChecksum(const std::vector<uint64_t> &words) {
+        uint64_t res = 0;
+        for (uint64_t word: words) {
+            res = mixHash(res ^ word);
+        }
+        return res;
+    }
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Parallel.h"
+#include "Sha256.h"
+
+// Read-only memory mapping of a whole file, the pages are read on first access and never copied
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            std::cerr << "Cannot open " << path << std::endl;
+            exit(1);
+        }
+        size_ = info.st_size;
+        if (size_ > 0) {
+            void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                std::cerr << "Cannot map " << path << std::endl;
+                exit(1);
+            }
+            madvise(data, size_, MADV_SEQUENTIAL);
+            data_ = (const uint8_t *) data;
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            munmap((void *) data_, size_);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/*
+ * Merkle tree over fixed-size chunks of a buffer: leaf = SHA-256(chunk), node = SHA-256(0x01 || left || right),
+ * an unpaired last node moves up a level unchanged. Leaves are hashed in parallel, full chunks through
+ * sha256Batch. The signed value also covers the data size and chunk size, so the tree shape is fixed.
+ * A chunk is checked against the root with its log2(chunks) sibling hashes, without the rest of the data.
+ */
+class MerkleTree {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+    static constexpr size_t PARALLEL_LEVEL_SIZE = 1024; // smaller levels are hashed by one thread
+
+    MerkleTree(const uint8_t *data, size_t size, size_t chunk_size, unsigned threads)
+            : size_(size), chunk_size_(chunk_size) {
+        threads = std::max(threads, 1u);
+        size_t chunks = chunkCount(size, chunk_size);
+        levels_.emplace_back(chunks);
+
+        std::vector<Sha256Digest> &leaves = levels_[0];
+        runThreads(threads, [&](unsigned t) {
+            size_t begin = chunks * t / threads;
+            size_t end = chunks * (t + 1) / threads;
+            size_t full_end = std::min(end, size / chunk_size);
+            std::vector<const uint8_t *> messages;
+            for (size_t i = begin; i < full_end; ++i) {
+                messages.push_back(data + i * chunk_size);
+            }
+            sha256Batch(messages.data(), chunk_size, messages.size(), leaves.data() + begin);
+            for (size_t i = std::max(begin, full_end); i < end; ++i) {
+                leaves[i] = Sha256::digest(data + i * chunk_size, std::min(chunk_size, size - i * chunk_size));
+            }
+        });
+
+        while (levels_.back().size() > 1) {
+            const std::vector<Sha256Digest> &level = levels_.back();
+            std::vector<Sha256Digest> parents((level.size() + 1) / 2);
+            unsigned level_threads = level.size() >= PARALLEL_LEVEL_SIZE ? threads : 1;
+            runThreads(level_threads, [&](unsigned t) {
+                for (size_t i = parents.size() * t / level_threads; i < parents.size() * (t + 1) / level_threads; ++i) {
+                    parents[i] = 2 * i + 1 < level.size() ? hashNode(level[2 * i], level[2 * i + 1]) : level[2 * i];
+                }
+            });
+            levels_.push_back(std::move(parents));
+        }
+    }
+
+    const Sha256Digest &root() const {
+        return levels_.back()[0];
+    }
+
+    size_t chunks() const {
+        return levels_[0].size();
+    }
+
+    // the digest to sign: SHA-256(root || data size || chunk size), sizes as 64-bit big-endian
+    Sha256Digest signedDigest() const {
+        return signedDigest(root(), size_, chunk_size_);
+    }
+
+    static Sha256Digest signedDigest(const Sha256Digest &root, uint64_t size, uint64_t chunk_size) {
+        uint8_t message[32 + 16];
+        std::copy(root.begin(), root.end(), message);
+        for (int i = 0; i < 8; ++i) {
+            message[32 + i] = (uint8_t) (size >> (56 - 8 * i));
+            message[40 + i] = (uint8_t) (chunk_size >> (56 - 8 * i));
+        }
+        return Sha256::digest(message, sizeof(message));
+    }
+
+    // sibling hashes from the leaf up, levels where the node has no sibling are skipped
+    std::vector<Sha256Digest> proof(size_t index) const {
+        std::vector<Sha256Digest> res;
+        for (size_t level = 0; level + 1 < levels_.size(); ++level, index /= 2) {
+            size_t sibling = index ^ 1;
+            if (sibling < levels_[level].size()) {
+                res.push_back(levels_[level][sibling]);
+            }
+        }
+        return res;
+    }
+
+    // root implied by one chunk and its proof, equal to the real root only if the chunk is intact
+    static Sha256Digest rootFromChunk(const uint8_t *chunk, size_t chunk_bytes, size_t index, size_t chunks,
+                                      const std::vector<Sha256Digest> &proof) {
+        Sha256Digest node = Sha256::digest(chunk, chunk_bytes);
+        size_t next = 0;
+        for (size_t width = chunks; width > 1; width = (width + 1) / 2, index /= 2) {
+            if ((index ^ 1) >= width) {
+                continue; // promoted without a sibling
+            }
+            if (next == proof.size()) {
+                return {};
+            }
+            const Sha256Digest &sibling = proof[next++];
+            node = index % 2 == 0 ? hashNode(node, sibling) : hashNode(sibling, node);
+        }
+        return node;
+    }
+
+    static size_t chunkCount(size_t size, size_t chunk_size) {
+        return std::max<size_t>(1, (size + chunk_size - 1) / chunk_size); // empty data is one empty chunk
+    }
+
+private:
+    size_t size_;
+    size_t chunk_size_;
+    std::vector<std::vector<Sha256Digest>> levels_; // levels_[0] are the leaves, levels_.back() is the root
+
+    static Sha256Digest hashNode(const Sha256Digest &left, const Sha256Digest &right) {
+        uint8_t message[1 + 2 * 32];
+        message[0] = 0x01;
+        std::copy(left.begin(), left.end(), message + 1);
+        std::copy(right.begin(), right.end(), message + 33);
+        return Sha256::digest(message, sizeof(message));
+    }
+};
+
+/*
+ * File mode of the signature tools: the file is memory-mapped and hashed as a Merkle tree on all threads,
+ * the tool signs signedDigest(). chunkDigest() then rebuilds that digest from a single chunk and its proof
+ * hashes, so checking it against the signature checks the chunk without the rest of the file.
+ */
+class MerkleFile {
+public:
+    MerkleFile(const std::string &path, size_t chunk_size, unsigned threads)
+            : path_(path), file_(path), chunk_size_(chunk_size), threads_(std::max(threads, 1u)),
+              start_time_(std::chrono::high_resolution_clock::now()),
+              tree_(file_.data(), file_.size(), chunk_size, threads_),
+              end_time_(std::chrono::high_resolution_clock::now()) {}
+
+    const MerkleTree &tree() const {
+        return tree_;
+    }
+
+    Sha256Digest signedDigest() const {
+        return tree_.signedDigest();
+    }
+
+    void printStats() const {
+        double seconds = std::chrono::duration<double>(end_time_ - start_time_).count();
+        std::cout << "File: " << path_ << " (" << file_.size() << " bytes, " << tree_.chunks() << " chunks of "
+                  << chunk_size_ << " bytes)" << std::endl;
+        std::cout << "Merkle root = " << toHex(tree_.root()) << std::endl;
+        std::cout << "Hashed in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end_time_ - start_time_).count() << " ms, "
+                  << (double) file_.size() / 1e6 / std::max(seconds, 1e-9) << " MB/s, threads = " << threads_
+                  << std::endl;
+    }
+
+    // the signed digest as implied by chunk index and its proof alone
+    Sha256Digest chunkDigest(size_t index) const {
+        if (index >= tree_.chunks()) {
+            std::cerr << "Chunk " << index << " is out of range, the file has " << tree_.chunks() << " chunks"
+                      << std::endl;
+            exit(1);
+        }
+        size_t offset = index * chunk_size_;
+        size_t chunk_bytes = std::min(chunk_size_, file_.size() - std::min(offset, file_.size()));
+        std::vector<Sha256Digest> proof = tree_.proof(index);
+        Sha256Digest root = MerkleTree::rootFromChunk(file_.data() + offset, chunk_bytes, index, tree_.chunks(),
+                                                      proof);
+        Sha256Digest digest = MerkleTree::signedDigest(root, file_.size(), chunk_size_);
+        std::cout << "Chunk " << index << " with " << proof.size() << " proof hashes gives digest " << toHex(digest)
+                  << std::endl;
+        return digest;
+    }
+
+private:
+    std::string path_;
+    MappedFile file_;
+    size_t chunk_size_;
+    unsigned threads_;
+    std::chrono::high_resolution_clock::time_point start_time_;
+    MerkleTree tree_;
+    std::chrono::high_resolution_clock::time_point end_time_;
+};
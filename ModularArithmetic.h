@@ -1,97 +1,133 @@
 #pragma once
 
+#include <cassert>
 #include <cstdint>
-
-class ModularArithmetic {
+#include <vector>
+#include "BigInt.h"
+#include "Exponentiation.h"
+#include "Montgomery.h"
+
+inline uint64_t mulMod(uint64_t a, uint64_t b, uint64_t modulus) {
+    return (uint64_t) ((unsigned __int128) a * b % modulus);
+}
+
+// T is uint64_t or BigInt
+template<typename T>
+class BasicModularArithmetic {
 public:
-    explicit ModularArithmetic(uint64_t modulus) : modulus_(modulus) {}
+    explicit BasicModularArithmetic(const T &modulus) : modulus_(modulus), montgomery_(modulus) {}
 
-    uint64_t add(uint64_t a, uint64_t b) const {
-        a %= modulus_;
-        b %= modulus_;
+    T add(T a, T b) const {
+        a = a % modulus_;
+        b = b % modulus_;
 
-        uint64_t res = a + b;
-        if (res >= modulus_ || res < a) {
+        T res = a + b;
+        if (res >= modulus_ || res < a) { // res < a only on uint64_t overflow
             res -= modulus_;
         }
 
         return res;
     }
 
-    uint64_t sub(uint64_t a, uint64_t b) const {
-        a %= modulus_;
-        b %= modulus_;
+    T sub(T a, T b) const {
+        a = a % modulus_;
+        b = b % modulus_;
 
-        uint64_t res = a - b;
-        if (res >= modulus_ || res > a) {
-            res += modulus_;
+        if (a >= b) {
+            return a - b;
         }
+        return modulus_ - (b - a);
+    }
 
-        return res;
+    T mul(const T &a, const T &b) const {
+        return mulMod(a, b, modulus_);
     }
 
-    uint64_t mul(uint64_t a, uint64_t b) const {
-        if (b == 0) {
-            return 0;
+    T pow(const T &base, const T &exponent) const {
+        if (modulus_ == T(1)) {
+            return T(0);
         }
-        if (b == 1) {
-            return a % modulus_;
+        if (exponent == T(0)) {
+            return T(1);
         }
-
-        uint64_t res = mul(a, b >> 1); // a * floor(b / 2)
-        res = add(res, res);
-        if (b & 1) { // если b нечетное, добавить еще один a
-            res = add(res, a);
+        if (!montgomery_.isValid()) { // even modulus, no Montgomery form
+            return slidingWindowPow(PlainReduction{*this}, base % modulus_, exponent);
         }
 
-        return res;
+        return montgomery_.fromMontgomery(slidingWindowPow(montgomery_, montgomery_.toMontgomery(base), exponent));
     }
 
-    uint64_t pow(uint64_t base, uint64_t exponent) const {
-        if (modulus_ == 1) {
-            return 0;
-        }
-        if (exponent == 0) {
-            return 1;
+    // product of bases[j]^exponents[j] with one shared squaring chain, see multiPow in Exponentiation.h
+    T multiPow(const std::vector<T> &bases, const std::vector<T> &exponents) const {
+        assert(bases.size() == exponents.size() && !bases.empty());
+        if (modulus_ == T(1)) {
+            return T(0);
         }
-
-        uint64_t res = 1;
-        uint64_t curr = base;
-
-        while (exponent > 0) {
-            if (exponent & 1) {
-                res = mul(res, curr);
+        std::vector<T> reduced(bases.size());
+        if (!montgomery_.isValid()) {
+            for (size_t j = 0; j < bases.size(); ++j) {
+                reduced[j] = bases[j] % modulus_;
             }
-
-            curr = mul(curr, curr);
-            exponent = exponent >> 1;
+            return ::multiPow(PlainReduction{*this}, reduced, exponents);
         }
 
-        return res;
+        for (size_t j = 0; j < bases.size(); ++j) {
+            reduced[j] = montgomery_.toMontgomery(bases[j]);
+        }
+        return montgomery_.fromMontgomery(::multiPow(montgomery_, reduced, exponents));
     }
 
-    uint64_t gcdExtended(uint64_t a, uint64_t b, uint64_t &x, uint64_t &y) {
-        if (b == 0) {
-            x = 1;
-            y = 0;
+    T gcdExtended(const T &a, const T &b, T &x, T &y) const {
+        if (b == T(0)) {
+            x = T(1);
+            y = T(0);
             return a;
         }
 
-        uint64_t x1, y1;
-        uint64_t d = gcdExtended(b, a % b, x1, y1);
+        T x1, y1;
+        T d = gcdExtended(b, a % b, x1, y1);
         x = y1;
         y = sub(x1, mul(y1, (a / b)));
 
         return d;
     }
 
-    uint64_t inv(uint64_t c) {
-        uint64_t c_inv, _;
-        uint64_t g = gcdExtended(c, modulus_, c_inv, _);
-        assert(g == 1);
+    T inv(const T &c) const {
+        T c_inv, _;
+        T g = gcdExtended(c, modulus_, c_inv, _);
+        assert(g == T(1));
         return c_inv;
     }
 
+    const T &modulus() const {
+        return modulus_;
+    }
+
+    const MontgomeryContext<T> &montgomery() const {
+        return montgomery_;
+    }
+
 private:
-    uint64_t modulus_;
-};
\ No newline at end of file
+    T modulus_;
+    MontgomeryContext<T> montgomery_;
+
+    struct PlainReduction {
+        using Element = T;
+
+        const BasicModularArithmetic &ma;
+
+        T one() const {
+            return T(1);
+        }
+
+        T mul(const T &a, const T &b) const {
+            return ma.mul(a, b);
+        }
+
+        T sqr(const T &a) const {
+            return ma.mul(a, a);
+        }
+    };
+};
+
+using ModularArithmetic = BasicModularArithmetic<uint64_t>;
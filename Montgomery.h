@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "BigInt.h"
+
+// Montgomery multiplication context for an odd modulus, specialized per integer type.
+// Values are kept in Montgomery form (a * R mod n), so modular products need no division.
+template<typename T>
+class MontgomeryContext;
+
+// n < 2^64, R = 2^64, a product costs two 64x64->128 multiplications
+template<>
+class MontgomeryContext<uint64_t> {
+public:
+    using Element = uint64_t;
+
+    explicit MontgomeryContext(uint64_t modulus) : modulus_(modulus) {
+        if (!isValid()) {
+            return;
+        }
+
+        // Newton iteration for n^-1 mod 2^64, every step doubles the number of correct bits
+        modulus_inv_ = modulus_;
+        for (int i = 0; i < 5; ++i) {
+            modulus_inv_ *= 2 - modulus_ * modulus_inv_;
+        }
+
+        one_ = (0 - modulus_) % modulus_; // R mod n
+        r2_ = (uint64_t) ((unsigned __int128) one_ * one_ % modulus_); // R^2 mod n
+    }
+
+    bool isValid() const {
+        return modulus_ > 1 && (modulus_ & 1);
+    }
+
+    uint64_t modulus() const {
+        return modulus_;
+    }
+
+    // Montgomery form of 1
+    uint64_t one() const {
+        return one_;
+    }
+
+    uint64_t toMontgomery(uint64_t a) const {
+        return reduce((unsigned __int128) (a % modulus_) * r2_);
+    }
+
+    uint64_t fromMontgomery(uint64_t a) const {
+        return reduce(a);
+    }
+
+    uint64_t mul(uint64_t a, uint64_t b) const {
+        return reduce((unsigned __int128) a * b);
+    }
+
+    uint64_t sqr(uint64_t a) const {
+        return reduce((unsigned __int128) a * a);
+    }
+
+    // t * R^-1 mod n for t < n * R
+    uint64_t reduce(unsigned __int128 t) const {
+        uint64_t t_lo = (uint64_t) t;
+        uint64_t t_hi = (uint64_t) (t >> 64);
+        uint64_t m = t_lo * modulus_inv_; // m * n == t (mod R), so low halves cancel out
+        uint64_t mn_hi = (uint64_t) (((unsigned __int128) m * modulus_) >> 64);
+        uint64_t res = t_hi - mn_hi;
+        if (t_hi < mn_hi) {
+            res += modulus_;
+        }
+        return res;
+    }
+
+private:
+    uint64_t modulus_;
+    uint64_t modulus_inv_ = 0;
+    uint64_t one_ = 0;
+    uint64_t r2_ = 0;
+};
+
+// n with k limbs, R = 2^(64k), products use the CIOS (coarsely integrated operand scanning) method
+template<>
+class MontgomeryContext<BigInt> {
+public:
+    using Element = BigInt;
+
+    explicit MontgomeryContext(const BigInt &modulus) : modulus_(modulus) {
+        if (!isValid()) {
+            return;
+        }
+
+        uint64_t n0 = modulus_.limb(0);
+        uint64_t n0_inv = n0;
+        for (int i = 0; i < 5; ++i) {
+            n0_inv *= 2 - n0 * n0_inv;
+        }
+        n0_neg_inv_ = 0 - n0_inv;
+
+        size_t k = modulus_.limbCount();
+        one_ = BigInt::powerOfTwo(64 * k) % modulus_;
+        r2_ = BigInt::powerOfTwo(128 * k) % modulus_;
+    }
+
+    bool isValid() const {
+        return modulus_ > BigInt(1) && modulus_.isOdd();
+    }
+
+    const BigInt &modulus() const {
+        return modulus_;
+    }
+
+    const BigInt &one() const {
+        return one_;
+    }
+
+    BigInt toMontgomery(const BigInt &a) const {
+        return mul(a < modulus_ ? a : a % modulus_, r2_);
+    }
+
+    BigInt fromMontgomery(const BigInt &a) const {
+        return mul(a, BigInt(1));
+    }
+
+    BigInt sqr(const BigInt &a) const {
+        return mul(a, a);
+    }
+
+    // a * b * R^-1 mod n for a, b < n
+    BigInt mul(const BigInt &a, const BigInt &b) const {
+        const std::vector<uint64_t> &n = modulus_.limbs();
+        size_t k = n.size();
+        std::vector<uint64_t> t(k + 2, 0);
+        std::vector<uint64_t> b_limbs = b.limbs();
+        b_limbs.resize(k, 0);
+
+        for (size_t i = 0; i < k; ++i) {
+            uint64_t a_i = a.limb(i);
+            uint64_t carry = 0;
+            for (size_t j = 0; j < k; ++j) {
+                unsigned __int128 cur = (unsigned __int128) a_i * b_limbs[j] + t[j] + carry;
+                t[j] = (uint64_t) cur;
+                carry = (uint64_t) (cur >> 64);
+            }
+            unsigned __int128 top = (unsigned __int128) t[k] + carry;
+            t[k] = (uint64_t) top;
+            t[k + 1] = (uint64_t) (top >> 64);
+
+            // add m * n so that the lowest limb becomes zero, then drop it
+            uint64_t m = t[0] * n0_neg_inv_;
+            unsigned __int128 cur = (unsigned __int128) m * n[0] + t[0];
+            carry = (uint64_t) (cur >> 64);
+            for (size_t j = 1; j < k; ++j) {
+                cur = (unsigned __int128) m * n[j] + t[j] + carry;
+                t[j - 1] = (uint64_t) cur;
+                carry = (uint64_t) (cur >> 64);
+            }
+            top = (unsigned __int128) t[k] + carry;
+            t[k - 1] = (uint64_t) top;
+            t[k] = t[k + 1] + (uint64_t) (top >> 64);
+            t[k + 1] = 0;
+        }
+
+        BigInt res = BigInt::fromLimbs(std::move(t));
+        if (res >= modulus_) {
+            res -= modulus_;
+        }
+        return res;
+    }
+
+private:
+    BigInt modulus_;
+    uint64_t n0_neg_inv_ = 0;
+    BigInt one_;
+    BigInt r2_;
+};
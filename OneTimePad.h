@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "CpuFeatures.h"
+
+/*
+ * One-time-pad kernels over byte buffers.
+ * Printable mode works on the 95 printable ASCII characters: out = in +- key (mod 95), shifted by ALPHABET_START.
+ * Reductions are done without division: for x < 2 * 95, min(x, x - 95) in 8-bit arithmetic is x mod 95,
+ * because x - 95 wraps around to a value above 160 exactly when x < 95.
+ * Bytes outside the alphabet (line breaks and so on) pass through unchanged but still use up a key byte,
+ * so a key byte always lines up with the same position of the input. Key bytes are reduced mod 95 first.
+ */
+constexpr unsigned char PAD_ALPHABET_START = 32; // first printable ASCII character
+constexpr unsigned char PAD_ALPHABET_SIZE = 95;
+
+inline unsigned char padReduce(unsigned char x) {
+    return std::min<unsigned char>(x, (unsigned char) (x - PAD_ALPHABET_SIZE));
+}
+
+inline void padPrintableScalar(const unsigned char *in, const unsigned char *key, unsigned char *out, size_t size,
+                               bool decrypt) {
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char a = in[i] - PAD_ALPHABET_START;
+        unsigned char b = padReduce(padReduce(key[i] - PAD_ALPHABET_START));
+        unsigned char res = decrypt
+                            ? std::min<unsigned char>(a - b, (unsigned char) (a - b + PAD_ALPHABET_SIZE))
+                            : padReduce(a + b);
+        out[i] = a < PAD_ALPHABET_SIZE ? res + PAD_ALPHABET_START : in[i];
+    }
+}
+
+inline void padXorScalar(const unsigned char *in, const unsigned char *key, unsigned char *out, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        out[i] = in[i] ^ key[i];
+    }
+}
+
+#ifdef X86_DISPATCH
+
+constexpr size_t PAD_AVX2_BYTES = 32;
+
+__attribute__((target("avx2")))
+inline void padPrintableAvx2(const unsigned char *in, const unsigned char *key, unsigned char *out, size_t size,
+                             bool decrypt) {
+    __m256i start = _mm256_set1_epi8((char) PAD_ALPHABET_START);
+    __m256i alphabet = _mm256_set1_epi8((char) PAD_ALPHABET_SIZE);
+    __m256i last = _mm256_set1_epi8((char) (PAD_ALPHABET_SIZE - 1));
+    size_t i = 0;
+    for (; i + PAD_AVX2_BYTES <= size; i += PAD_AVX2_BYTES) {
+        __m256i m = _mm256_loadu_si256((const __m256i *) (in + i));
+        __m256i k = _mm256_loadu_si256((const __m256i *) (key + i));
+        __m256i a = _mm256_sub_epi8(m, start);
+        __m256i printable = _mm256_cmpeq_epi8(_mm256_min_epu8(a, last), a);
+        __m256i b = _mm256_sub_epi8(k, start);
+        b = _mm256_min_epu8(b, _mm256_sub_epi8(b, alphabet));
+        b = _mm256_min_epu8(b, _mm256_sub_epi8(b, alphabet));
+        __m256i res;
+        if (decrypt) {
+            res = _mm256_sub_epi8(a, b);
+            res = _mm256_min_epu8(res, _mm256_add_epi8(res, alphabet));
+        } else {
+            res = _mm256_add_epi8(a, b);
+            res = _mm256_min_epu8(res, _mm256_sub_epi8(res, alphabet));
+        }
+        res = _mm256_blendv_epi8(m, _mm256_add_epi8(res, start), printable);
+        _mm256_storeu_si256((__m256i *) (out + i), res);
+    }
+    padPrintableScalar(in + i, key + i, out + i, size - i, decrypt);
+}
+
+__attribute__((target("avx2")))
+inline void padXorAvx2(const unsigned char *in, const unsigned char *key, unsigned char *out, size_t size) {
+    size_t i = 0;
+    for (; i + PAD_AVX2_BYTES <= size; i += PAD_AVX2_BYTES) {
+        __m256i m = _mm256_loadu_si256((const __m256i *) (in + i));
+        __m256i k = _mm256_loadu_si256((const __m256i *) (key + i));
+        _mm256_storeu_si256((__m256i *) (out + i), _mm256_xor_si256(m, k));
+    }
+    padXorScalar(in + i, key + i, out + i, size - i);
+}
+
+#endif
+
+// out may be the same buffer as in
+inline void padPrintable(const unsigned char *in, const unsigned char *key, unsigned char *out, size_t size,
+                         bool decrypt) {
+#ifdef X86_DISPATCH
+    if (hasAvx2()) {
+        padPrintableAvx2(in, key, out, size, decrypt);
+        return;
+    }
+#endif
+    padPrintableScalar(in, key, out, size, decrypt);
+}
+
+// out may be the same buffer as in, encryption and decryption are the same operation
+inline void padXor(const unsigned char *in, const unsigned char *key, unsigned char *out, size_t size) {
+#ifdef X86_DISPATCH
+    if (hasAvx2()) {
+        padXorAvx2(in, key, out, size);
+        return;
+    }
+#endif
+    padXorScalar(in, key, out, size);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+inline unsigned defaultThreadCount() {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// runs worker(thread_index) on `threads` threads, the calling thread is index 0
+template<typename Worker>
+void runThreads(unsigned threads, Worker worker) {
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; ++i) {
+        pool.emplace_back(worker, i);
+    }
+    worker(0u);
+    for (std::thread &thread: pool) {
+        thread.join();
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "BabyStepGiantStep.h"
+#include "functions.h"
+#include "ModularArithmetic.h"
+
+/*
+ * Pohlig-Hellman for g^x == y (mod p) with p prime.
+ * p - 1 is factored, x mod q^e is found digit by digit in the subgroup of order q for every q^e dividing p - 1,
+ * each digit with baby-step giant-step, and the residues are joined with the CRT.
+ * The cost is about sqrt(largest factor of p - 1) instead of sqrt(p).
+ */
+class PohligHellman {
+public:
+    PohligHellman(uint64_t p, uint64_t g, unsigned threads)
+            : p_(p), g_(g), threads_(std::max(threads, 1u)), factors_(factorize(p - 1)) {}
+
+    const std::vector<std::pair<uint64_t, unsigned>> &factors() const {
+        return factors_;
+    }
+
+    // 1 when p - 1 has no prime factors, i.e. p = 2
+    uint64_t largestFactor() const {
+        return factors_.empty() ? 1 : factors_.back().first;
+    }
+
+    bool solve(uint64_t y, uint64_t &x) const {
+        ModularArithmetic ma(p_);
+        uint64_t order = p_ - 1;
+
+        uint64_t res = 0;
+        uint64_t res_modulus = 1;
+        for (auto [q, e]: factors_) {
+            uint64_t full_power = 1;
+            for (unsigned k = 0; k < e; ++k) {
+                full_power *= q;
+            }
+
+            // project into the subgroup of order q^e, where g may only generate a subgroup of order q^f, f <= e
+            uint64_t g_sub = ma.pow(g_, order / full_power);
+            uint64_t y_sub = ma.pow(y, order / full_power);
+            unsigned f = 0;
+            uint64_t prime_power = 1;
+            for (uint64_t power = g_sub; power != 1; power = ma.pow(power, q)) {
+                ++f;
+                prime_power *= q;
+            }
+            if (f == 0) {
+                continue;
+            }
+
+            uint64_t residue;
+            if (!solvePrimePower(ma, g_sub, y_sub, q, f, residue)) {
+                return false;
+            }
+
+            // res = res (mod res_modulus) and res = residue (mod prime_power)
+            ModularArithmetic crt(prime_power);
+            uint64_t t = crt.mul(crt.sub(residue, res), crt.inv(res_modulus % prime_power));
+            res += res_modulus * t;
+            res_modulus *= prime_power;
+        }
+
+        if (ma.pow(g_, res) != y) { // g does not generate a group with a solution
+            return false;
+        }
+        x = res;
+        return true;
+    }
+
+private:
+    uint64_t p_;
+    uint64_t g_;
+    unsigned threads_;
+    std::vector<std::pair<uint64_t, unsigned>> factors_;
+
+    // x mod q^e as d_0 + d_1 q + ... + d_(e-1) q^(e-1), each digit a discrete log in the subgroup of order q
+    bool solvePrimePower(const ModularArithmetic &ma, uint64_t g_sub, uint64_t y_sub, uint64_t q, unsigned e,
+                         uint64_t &x) const {
+        uint64_t q_power = 1; // q^(e-1)
+        for (unsigned k = 1; k < e; ++k) {
+            q_power *= q;
+        }
+        uint64_t gamma = ma.pow(g_sub, q_power);
+
+        uint64_t n = (uint64_t) std::ceil(std::sqrt((double) q));
+        BabyStepTable table(ma, gamma, n, threads_);
+        uint64_t g_sub_inv = ma.inv(g_sub);
+
+        x = 0;
+        uint64_t digit_weight = 1; // q^k
+        for (unsigned k = 0; k < e; ++k) {
+            // (g^-x * y)^(q^(e-1-k)) = gamma^d_k
+            uint64_t target = ma.pow(ma.mul(ma.pow(g_sub_inv, x), y_sub), q_power);
+            uint64_t digit;
+            if (!babyStepGiantStep(ma, table, gamma, target, n, threads_, digit)) {
+                return false;
+            }
+            x += digit * digit_weight;
+            digit_weight *= q;
+            q_power /= q;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "functions.h"
+#include "ModularArithmetic.h"
+#include "Parallel.h"
+#include "Randomizer.h"
+
+/*
+ * Distinguished points shared by all walks of a solver.
+ * A point is distinguished when the low dp_bits bits of its hash are zero, so each walk
+ * only stores roughly one point out of 2^dp_bits and memory stays independent of the walk length.
+ */
+template<typename Entry>
+class DistinguishedPointTable {
+public:
+    explicit DistinguishedPointTable(unsigned dp_bits) : mask_(((uint64_t) 1 << dp_bits) - 1) {}
+
+    bool isDistinguished(uint64_t point) const {
+        return (mixHash(point) & mask_) == 0;
+    }
+
+    // stores the entry for a new point, otherwise returns false and the entry already stored
+    bool insert(uint64_t point, const Entry &entry, Entry &existing) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [it, inserted] = points_.emplace(point, entry);
+        if (!inserted) {
+            existing = it->second;
+        }
+        return inserted;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return points_.size();
+    }
+
+private:
+    uint64_t mask_;
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, Entry> points_;
+};
+
+// distinguished points are about sqrt(steps) apart, so the table holds about sqrt(sqrt(order)) entries
+inline unsigned defaultDistinguishedBits(uint64_t order) {
+    return (unsigned) bitLength(order) / 4;
+}
+
+/*
+ * Parallel Pollard rho for g^x == y (mod p) with an r-adding walk.
+ * Every thread walks X = g^a * y^b, exponents are kept modulo the order of g, and
+ * two walks meeting at a distinguished point give a + b*x == a' + b'*x (mod order).
+ */
+class PollardRho {
+public:
+    static constexpr unsigned PARTITIONS = 32;
+    static constexpr uint64_t SMALL_ORDER = 1 << 10; // below that a walk cycles before it finds anything
+
+    PollardRho(uint64_t p, uint64_t g, unsigned threads, unsigned dp_bits)
+            : p_(p), g_(g), order_(multiplicativeOrder(g, p, p - 1)), threads_(std::max(threads, 1u)), dp_bits_(dp_bits) {}
+
+    bool solve(uint64_t y, uint64_t seed, uint64_t &x) {
+        ModularArithmetic ma(p_);
+        if (y == 1) {
+            x = 0;
+            return true;
+        }
+        if (order_ <= SMALL_ORDER) {
+            // also covers order 1, where every collision has b == b' and tells nothing
+            uint64_t power = 1;
+            for (uint64_t i = 0; i < order_; ++i, power = ma.mul(power, g_)) {
+                if (power == y) {
+                    x = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+        ModularArithmetic exponents(order_);
+
+        // multipliers M_k = g^a_k * y^b_k, chosen by the hash of the current point
+        Randomizer randomizer(seed);
+        std::vector<uint64_t> step_a(PARTITIONS), step_b(PARTITIONS), step(PARTITIONS);
+        for (unsigned k = 0; k < PARTITIONS; ++k) {
+            step_a[k] = randomizer.random(0, order_ - 1);
+            step_b[k] = randomizer.random(0, order_ - 1);
+            step[k] = ma.multiPow({g_, y}, {step_a[k], step_b[k]});
+        }
+
+        DistinguishedPointTable<std::pair<uint64_t, uint64_t>> table(dp_bits_);
+        std::atomic<bool> done{false};
+        std::mutex result_mutex;
+        uint64_t max_walk = (uint64_t) 20 << dp_bits_; // a walk without distinguished points is stuck in a cycle
+        // about sqrt(order) / 2^dp_bits walks meet, far more means y is not a power of g
+        uint64_t max_walks = MAX_WALKS_FACTOR * (((uint64_t) std::sqrt((double) order_) >> dp_bits_) + threads_);
+        std::atomic<uint64_t> walks{0};
+
+        runThreads(threads_, [&](unsigned t) {
+            Randomizer thread_randomizer = randomizer.stream(t);
+            while (!done.load(std::memory_order_relaxed)) {
+                if (walks++ >= max_walks) {
+                    return;
+                }
+                uint64_t a = thread_randomizer.random(0, order_ - 1);
+                uint64_t b = thread_randomizer.random(0, order_ - 1);
+                uint64_t point = ma.multiPow({g_, y}, {a, b});
+
+                for (uint64_t i = 0; i < max_walk && !done.load(std::memory_order_relaxed); ++i) {
+                    std::pair<uint64_t, uint64_t> other;
+                    if (table.isDistinguished(point) && !table.insert(point, {a, b}, other)) {
+                        uint64_t candidate;
+                        if (solveCollision(ma, y, a, b, other.first, other.second, candidate)) {
+                            std::lock_guard<std::mutex> lock(result_mutex);
+                            if (!done.exchange(true)) {
+                                x = candidate;
+                            }
+                        }
+                        break; // useless collision, restart from a fresh random point
+                    }
+
+                    unsigned k = mixHash(point) >> 59; // top log2(PARTITIONS) bits
+                    point = ma.mul(point, step[k]);
+                    a = exponents.add(a, step_a[k]);
+                    b = exponents.add(b, step_b[k]);
+                }
+            }
+        });
+
+        return done.load();
+    }
+
+private:
+    uint64_t p_;
+    uint64_t g_;
+    uint64_t order_;
+    unsigned threads_;
+    unsigned dp_bits_;
+
+    // a1 + b1*x == a2 + b2*x (mod order), every root modulo order / gcd is tried against y
+    bool solveCollision(const ModularArithmetic &ma, uint64_t y, uint64_t a1, uint64_t b1, uint64_t a2, uint64_t b2,
+                        uint64_t &x) const {
+        ModularArithmetic exponents(order_);
+        uint64_t db = exponents.sub(b2, b1);
+        uint64_t da = exponents.sub(a1, a2);
+        uint64_t d = gcd(db, order_);
+        if (db == 0 || da % d != 0 || d > MAX_ROOTS) {
+            return false;
+        }
+
+        uint64_t reduced_order = order_ / d;
+        ModularArithmetic reduced(reduced_order);
+        uint64_t root = reduced_order == 1 ? 0 : reduced.mul(da / d, reduced.inv(db / d % reduced_order));
+        for (uint64_t k = 0; k < d; ++k) {
+            uint64_t candidate = root + k * reduced_order;
+            if (ma.pow(g_, candidate) == y) {
+                x = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static constexpr uint64_t MAX_ROOTS = 1 << 16;
+    static constexpr uint64_t MAX_WALKS_FACTOR = 64;
+};
+
+/*
+ * Parallel Pollard kangaroo (lambda) for g^x == y (mod p) with x known to lie in [lo, hi].
+ * Every thread runs one tame kangaroo starting near the middle of the interval and one wild kangaroo
+ * starting at y. Jumps are powers of two with mean about sqrt(hi - lo) * kangaroos / 4, and a tame and a wild
+ * kangaroo landing on the same distinguished point give x = tame exponent - wild distance (mod p - 1).
+ */
+class PollardKangaroo {
+public:
+    PollardKangaroo(uint64_t p, uint64_t g, unsigned threads, unsigned dp_bits)
+            : p_(p), g_(g), threads_(std::max(threads, 1u)), dp_bits_(dp_bits) {}
+
+    bool solve(uint64_t y, uint64_t lo, uint64_t hi, uint64_t &x) {
+        ModularArithmetic ma(p_);
+        ModularArithmetic exponents(p_ - 1);
+        uint64_t width = hi - lo;
+        unsigned kangaroos = 2 * threads_;
+
+        double target_mean = std::max(1.0, std::sqrt((double) width) * kangaroos / 4);
+        unsigned jump_count = 1;
+        while (jump_count < 63 && (double) (((uint64_t) 1 << jump_count) - 1) / jump_count < target_mean) {
+            ++jump_count;
+        }
+        std::vector<uint64_t> jump(jump_count), jump_power(jump_count);
+        for (unsigned k = 0; k < jump_count; ++k) {
+            jump[k] = (uint64_t) 1 << k;
+            jump_power[k] = ma.pow(g_, jump[k]);
+        }
+
+        struct Entry {
+            uint64_t exponent; // absolute exponent for a tame kangaroo, distance from y for a wild one
+            bool tame;
+        };
+        DistinguishedPointTable<Entry> table(dp_bits_);
+        std::atomic<bool> done{false};
+        std::mutex result_mutex;
+        // the expected total is about 2 * sqrt(width) jumps, after many times that x is assumed to be outside
+        uint64_t max_jumps = (uint64_t) (64 * std::sqrt((double) width) / kangaroos) + ((uint64_t) 64 << dp_bits_);
+
+        runThreads(threads_, [&](unsigned t) {
+            // spacing by the thread index keeps kangaroos of the same kind on distinct paths
+            Entry tame{lo + width / 2 + t, true};
+            Entry wild{t, false};
+            uint64_t tame_point = ma.pow(g_, tame.exponent);
+            uint64_t wild_point = ma.mul(y, ma.pow(g_, wild.exponent));
+
+            for (uint64_t i = 0; i < max_jumps && !done.load(std::memory_order_relaxed); ++i) {
+                for (auto [point, entry]: {std::make_pair(&tame_point, &tame), std::make_pair(&wild_point, &wild)}) {
+                    Entry other;
+                    if (table.isDistinguished(*point) && !table.insert(*point, *entry, other)) {
+                        if (other.tame == entry->tame) {
+                            // two kangaroos of the same kind merged, push this one off the shared path
+                            *point = ma.mul(*point, ma.pow(g_, kangaroos + t));
+                            entry->exponent += kangaroos + t;
+                            continue;
+                        }
+                        const Entry &tame_entry = entry->tame ? *entry : other;
+                        const Entry &wild_entry = entry->tame ? other : *entry;
+                        uint64_t candidate = exponents.sub(tame_entry.exponent, wild_entry.exponent);
+                        if (ma.pow(g_, candidate) == y) {
+                            std::lock_guard<std::mutex> lock(result_mutex);
+                            if (!done.exchange(true)) {
+                                x = candidate;
+                            }
+                            return;
+                        }
+                    }
+                    unsigned k = mixHash(*point) % jump_count;
+                    *point = ma.mul(*point, jump_power[k]);
+                    entry->exponent += jump[k];
+                }
+            }
+        });
+
+        return done.load();
+    }
+
+private:
+    uint64_t p_;
+    uint64_t g_;
+    unsigned threads_;
+    unsigned dp_bits_;
+};
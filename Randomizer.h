@@ -1,16 +1,54 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <random>
+#include <vector>
+#include "ChaCha20.h"
 #include "functions.h"
 
+/*
+ * MT19937 keeps the outputs of the labs reproducible, CHACHA20 is a CSPRNG that fills a buffer of
+ * keystream blocks at a time and samples bounded values from it without modulo bias.
+ */
 class Randomizer {
 public:
-    explicit Randomizer(uint64_t seed) : mt_(std::mt19937_64(seed)) {}
+    enum Backend {
+        MT19937,
+        CHACHA20,
+    };
+
+    explicit Randomizer(uint64_t seed, Backend backend = MT19937) : Randomizer(seed, backend, 0) {}
+
+    // independent generator number index derived from the same seed, e.g. one per thread
+    Randomizer stream(uint64_t index) const {
+        if (backend_ == CHACHA20) {
+            return Randomizer(seed_, CHACHA20, index + 1);
+        }
+        return Randomizer(mixHash(seed_ ^ mixHash(index + 1)), MT19937, 0);
+    }
 
     // random int from [min, max]
     uint64_t random(uint64_t min, uint64_t max) {
-        std::uniform_int_distribution<uint64_t> dist(min, max);
-        return dist(mt_);
+        if (backend_ == MT19937) {
+            std::uniform_int_distribution<uint64_t> dist(min, max);
+            return dist(mt_);
+        }
+        return min + bounded(max - min + 1);
+    }
+
+    // 64 uniformly random bits
+    uint64_t next() {
+        if (backend_ == MT19937) {
+            return mt_();
+        }
+        if (position_ + 2 > buffer_.size()) {
+            refill();
+        }
+        uint64_t res = (uint64_t) buffer_[position_ + 1] << 32 | buffer_[position_];
+        position_ += 2;
+        return res;
     }
 
     uint64_t randomPrime(uint64_t min, uint64_t max) {
@@ -22,6 +60,41 @@ public:
         return res;
     }
 
+    // bits uniformly random bits, 64 per draw
+    BigInt randomBits(size_t bits) {
+        std::vector<BigInt::Limb> limbs((bits + 63) / 64);
+        for (BigInt::Limb &limb: limbs) {
+            limb = next();
+        }
+        if (bits % 64 != 0) {
+            limbs.back() &= ((BigInt::Limb) 1 << (bits % 64)) - 1;
+        }
+        return BigInt::fromLimbs(std::move(limbs));
+    }
+
+    // random BigInt from [min, max], out of range draws are rejected so there is no modulo bias
+    BigInt random(const BigInt &min, const BigInt &max) {
+        BigInt range = max - min;
+        BigInt res;
+        do {
+            res = randomBits(range.bitLength());
+        } while (res > range);
+
+        return min + res;
+    }
+
+    // odd prime of exactly bits bits with the top two set, so a product of two such primes has all the bits
+    BigInt randomBigPrime(size_t bits) {
+        assert(bits >= 3);
+        BigInt top = BigInt::powerOfTwo(bits - 1) + BigInt::powerOfTwo(bits - 2) + BigInt(1);
+        BigInt res;
+        do {
+            res = top + (randomBits(bits - 3) << 1);
+        } while (!isPrime(res));
+
+        return res;
+    }
+
     uint64_t randomCoprime(uint64_t min, uint64_t max, uint64_t b) {
         uint64_t res;
         do {
@@ -31,17 +104,80 @@ public:
         return res;
     }
 
+    // uniformly random bytes, 8 per draw from MT19937 or straight from the ChaCha20 keystream
+    void fillBytes(unsigned char *data, size_t size) {
+        if (backend_ == MT19937) {
+            for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+                uint64_t word = mt_();
+                std::memcpy(data + i, &word, std::min(sizeof(uint64_t), size - i));
+            }
+            return;
+        }
+        while (size > 0) {
+            if (position_ == buffer_.size()) {
+                refill();
+            }
+            size_t bytes = std::min(size, (buffer_.size() - position_) * sizeof(uint32_t));
+            std::memcpy(data, buffer_.data() + position_, bytes);
+            position_ += (bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+            data += bytes;
+            size -= bytes;
+        }
+    }
+
     void shuffle(std::vector<uint64_t> &vec) {
-        std::shuffle(vec.begin(), vec.end(), mt_);
+        if (backend_ == MT19937) {
+            std::shuffle(vec.begin(), vec.end(), mt_);
+            return;
+        }
+        for (size_t i = vec.size(); i > 1; --i) {
+            std::swap(vec[i - 1], vec[bounded(i)]);
+        }
     }
 
+    // removes and returns a uniformly random element, the order of the rest is not kept
     uint64_t pick(std::vector<uint64_t> &vec) {
-        shuffle(vec);
+        std::swap(vec[random(0, vec.size() - 1)], vec.back());
         uint64_t res = vec.back();
         vec.pop_back();
         return res;
     }
 
 private:
+    static constexpr size_t BUFFER_BLOCKS = 32;
+
+    uint64_t seed_;
+    Backend backend_;
     std::mt19937_64 mt_;
+    ChaCha20 chacha_;
+    std::vector<uint32_t> buffer_;
+    size_t position_ = 0;
+
+    Randomizer(uint64_t seed, Backend backend, uint64_t stream)
+            : seed_(seed), backend_(backend), mt_(seed), chacha_(ChaCha20::keyFromSeed(seed), stream) {
+        if (backend_ == CHACHA20) {
+            buffer_.resize(BUFFER_BLOCKS * ChaCha20::BLOCK_WORDS);
+            position_ = buffer_.size();
+        }
+    }
+
+    void refill() {
+        chacha_.generate(buffer_.data(), BUFFER_BLOCKS);
+        position_ = 0;
+    }
+
+    // uniform in [0, range), range 0 means all 64 bits; Lemire's multiply-shift with rejection of the biased part
+    uint64_t bounded(uint64_t range) {
+        if (range == 0) {
+            return next();
+        }
+        unsigned __int128 product = (unsigned __int128) next() * range;
+        if ((uint64_t) product < range) {
+            uint64_t threshold = -range % range; // 2^64 mod range
+            while ((uint64_t) product < threshold) {
+                product = (unsigned __int128) next() * range;
+            }
+        }
+        return (uint64_t) (product >> 64);
+    }
 };
\ No newline at end of file
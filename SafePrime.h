@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "functions.h"
+#include "Parallel.h"
+#include "Randomizer.h"
+
+/*
+ * Parallel search for q such that both q and 2q + 1 are prime.
+ * Each round draws a random odd start from the randomizer and searches the next WINDOW_SIZE odd candidates.
+ * The window is split into chunks of about the expected gap between hits over the thread count, so all threads
+ * usually share the stretch before the first hit. A chunk is sieved for q and 2q + 1 at once, and only the
+ * survivors get Miller-Rabin. The answer is the smallest hit in the window, so it does not depend on the thread count.
+ */
+class SafePrimeSearch {
+public:
+    static constexpr uint64_t WINDOW_SIZE = 1 << 15; // odd candidates per round
+    static constexpr uint64_t MIN_CHUNK_SIZE = 1 << 8; // below that the sieve setup outweighs the tests
+    static constexpr uint64_t SIEVE_LIMIT = 1 << 14;
+
+    explicit SafePrimeSearch(unsigned threads = defaultThreadCount()) : threads_(std::max(threads, 1u)) {}
+
+    // random q from [min, max] such that 2q + 1 is a safe prime, max must be below UINT64_MAX / 2
+    uint64_t randomPrimeFactor(Randomizer &randomizer, uint64_t min, uint64_t max) const {
+        min = std::max(min, SIEVE_LIMIT + 1); // smaller q could be struck out by being a sieve prime itself
+        while (true) {
+            uint64_t start = randomizer.random(min, max) | 1;
+            uint64_t res = searchWindow(start, max);
+            if (res != 0) {
+                return res;
+            }
+        }
+    }
+
+private:
+    unsigned threads_;
+
+    static const std::vector<uint64_t> &sievePrimes() {
+        static const std::vector<uint64_t> primes = [] {
+            std::vector<uint64_t> res;
+            std::vector<bool> composite(SIEVE_LIMIT, false);
+            for (uint64_t i = 3; i < SIEVE_LIMIT; i += 2) {
+                if (composite[i]) {
+                    continue;
+                }
+                res.push_back(i);
+                for (uint64_t j = i * i; j < SIEVE_LIMIT; j += 2 * i) {
+                    composite[j] = true;
+                }
+            }
+            return res;
+        }();
+        return primes;
+    }
+
+    // odd candidates between two hits near q: q and 2q + 1 are both prime with odds 2.64 / (ln q * ln 2q)
+    static uint64_t expectedGap(uint64_t q) {
+        double log_q = std::log((double) q);
+        return (uint64_t) (log_q * (log_q + std::log(2.0)) / 2.64) + 1;
+    }
+
+    // chunks are claimed in increasing order, so once chunk k has a hit every chunk below k is already taken
+    uint64_t searchWindow(uint64_t start, uint64_t max) const {
+        uint64_t chunk_size = std::clamp<uint64_t>(expectedGap(start) / threads_, MIN_CHUNK_SIZE, WINDOW_SIZE);
+        unsigned chunks = (unsigned) ((WINDOW_SIZE + chunk_size - 1) / chunk_size);
+        std::atomic<unsigned> next_chunk{0};
+        std::atomic<unsigned> found_chunk{chunks};
+        std::vector<uint64_t> results(chunks, 0);
+
+        auto worker = [&](unsigned) {
+            while (true) {
+                unsigned k = next_chunk++;
+                if (k >= found_chunk.load()) {
+                    return;
+                }
+                uint64_t offset = 2 * chunk_size * k;
+                if (offset > max - start) {
+                    return;
+                }
+                uint64_t count = std::min({chunk_size, WINDOW_SIZE - chunk_size * k, (max - start - offset) / 2 + 1});
+                results[k] = searchChunk(start + offset, count, [&] { return found_chunk.load() < k; });
+                unsigned found = found_chunk.load();
+                while (results[k] != 0 && k < found && !found_chunk.compare_exchange_weak(found, k)) {}
+            }
+        };
+
+        runThreads(threads_, worker);
+
+        unsigned found = found_chunk.load();
+        return found < chunks ? results[found] : 0;
+    }
+
+    // first q = lo + 2i, i < count, with q and 2q + 1 prime, or 0
+    template<typename Cancelled>
+    static uint64_t searchChunk(uint64_t lo, uint64_t count, Cancelled cancelled) {
+        std::vector<bool> sieved_out(count, false);
+        for (uint64_t p: sievePrimes()) {
+            uint64_t half = (p + 1) / 2; // 2^-1 mod p
+            uint64_t lo_mod = lo % p;
+            // q == 0 (mod p) and 2q + 1 == 0 (mod p), i.e. q == (p - 1) / 2 (mod p)
+            for (uint64_t residue: {uint64_t(0), (p - 1) / 2}) {
+                uint64_t i = (residue + p - lo_mod) % p * half % p;
+                for (; i < count; i += p) {
+                    sieved_out[i] = true;
+                }
+            }
+        }
+
+        for (uint64_t i = 0; i < count; ++i) {
+            if (sieved_out[i]) {
+                continue;
+            }
+            if (cancelled()) {
+                return 0;
+            }
+            uint64_t q = lo + 2 * i;
+            if (isPrime(q) && isPrime(2 * q + 1)) {
+                return q;
+            }
+        }
+        return 0;
+    }
+};
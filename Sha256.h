@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "CpuFeatures.h"
+
+using Sha256Digest = std::array<uint8_t, 32>;
+
+constexpr size_t SHA256_BLOCK_SIZE = 64;
+
+constexpr uint32_t SHA256_K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+constexpr uint32_t SHA256_INITIAL_STATE[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+inline uint32_t loadBigEndian32(const uint8_t *data) {
+    return (uint32_t) data[0] << 24 | (uint32_t) data[1] << 16 | (uint32_t) data[2] << 8 | data[3];
+}
+
+inline void storeBigEndian32(uint8_t *data, uint32_t value) {
+    data[0] = (uint8_t) (value >> 24);
+    data[1] = (uint8_t) (value >> 16);
+    data[2] = (uint8_t) (value >> 8);
+    data[3] = (uint8_t) value;
+}
+
+inline uint32_t rotr32(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+inline void sha256CompressScalar(uint32_t *state, const uint8_t *data, size_t blocks) {
+    for (; blocks > 0; --blocks, data += SHA256_BLOCK_SIZE) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = loadBigEndian32(data + 4 * i);
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+            uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#ifdef X86_DISPATCH
+
+// SHA extensions keep the state as ABEF / CDGH and run two rounds per sha256rnds2
+__attribute__((target("sha,sse4.1")))
+inline void sha256CompressShaNi(uint32_t *state, const uint8_t *data, size_t blocks) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0xB1); // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (state + 4)), 0x1B); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0); // CDGH
+
+    for (; blocks > 0; --blocks, data += SHA256_BLOCK_SIZE) {
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+        __m128i msg[16]; // 4 schedule words per group of 4 rounds
+        for (int g = 0; g < 16; ++g) {
+            if (g < 4) {
+                msg[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 16 * g)), byte_swap);
+            } else {
+                __m128i x = _mm_sha256msg1_epu32(msg[g - 4], msg[g - 3]);
+                x = _mm_add_epi32(x, _mm_alignr_epi8(msg[g - 1], msg[g - 2], 4));
+                msg[g] = _mm_sha256msg2_epu32(x, msg[g - 1]);
+            }
+            __m128i words = _mm_add_epi32(msg[g], _mm_loadu_si128((const __m128i *) (SHA256_K + 4 * g)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, words);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(words, 0x0E));
+        }
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B); // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1); // DCHG
+    _mm_storeu_si128((__m128i *) state, _mm_blend_epi16(tmp, state1, 0xF0)); // DCBA
+    _mm_storeu_si128((__m128i *) (state + 4), _mm_alignr_epi8(state1, tmp, 8)); // HGFE
+}
+
+constexpr size_t SHA256_AVX2_LANES = 8;
+
+__attribute__((target("avx2")))
+inline __m256i rotr32Avx2(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// one block of each of 8 messages, state[i] holds word i of all 8 states
+__attribute__((target("avx2")))
+inline void sha256CompressAvx2x8(__m256i *state, const uint8_t *const *blocks) {
+    __m256i w[64];
+    for (int i = 0; i < 16; ++i) {
+        alignas(32) uint32_t words[SHA256_AVX2_LANES];
+        for (size_t lane = 0; lane < SHA256_AVX2_LANES; ++lane) {
+            words[lane] = loadBigEndian32(blocks[lane] + 4 * i);
+        }
+        w[i] = _mm256_load_si256((const __m256i *) words);
+    }
+    for (int i = 16; i < 64; ++i) {
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr32Avx2(w[i - 15], 7), rotr32Avx2(w[i - 15], 18)),
+                                      _mm256_srli_epi32(w[i - 15], 3));
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr32Avx2(w[i - 2], 17), rotr32Avx2(w[i - 2], 19)),
+                                      _mm256_srli_epi32(w[i - 2], 10));
+        w[i] = _mm256_add_epi32(_mm256_add_epi32(w[i - 16], s0), _mm256_add_epi32(w[i - 7], s1));
+    }
+
+    __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+    __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(rotr32Avx2(e, 6), rotr32Avx2(e, 11)), rotr32Avx2(e, 25));
+        __m256i choice = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1), _mm256_add_epi32(choice, w[i]));
+        t1 = _mm256_add_epi32(t1, _mm256_set1_epi32((int) SHA256_K[i]));
+        __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(rotr32Avx2(a, 2), rotr32Avx2(a, 13)), rotr32Avx2(a, 22));
+        __m256i majority = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i t2 = _mm256_add_epi32(sigma0, majority);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+    state[0] = _mm256_add_epi32(state[0], a);
+    state[1] = _mm256_add_epi32(state[1], b);
+    state[2] = _mm256_add_epi32(state[2], c);
+    state[3] = _mm256_add_epi32(state[3], d);
+    state[4] = _mm256_add_epi32(state[4], e);
+    state[5] = _mm256_add_epi32(state[5], f);
+    state[6] = _mm256_add_epi32(state[6], g);
+    state[7] = _mm256_add_epi32(state[7], h);
+}
+
+#endif
+
+// whole blocks of one message, with SHA-NI when the CPU has it
+inline void sha256Compress(uint32_t *state, const uint8_t *data, size_t blocks) {
+#ifdef X86_DISPATCH
+    if (hasShaNi()) {
+        sha256CompressShaNi(state, data, blocks);
+        return;
+    }
+#endif
+    sha256CompressScalar(state, data, blocks);
+}
+
+// last partial block of a message of size bytes plus padding: 0x80, zeros, 64-bit big-endian bit length.
+// rest points at the size % 64 trailing bytes, returns the number of tail blocks, 1 or 2
+inline size_t sha256Tail(const uint8_t *rest, uint64_t size, uint8_t *tail) {
+    size_t rest_size = size % SHA256_BLOCK_SIZE;
+    size_t tail_blocks = rest_size + 9 <= SHA256_BLOCK_SIZE ? 1 : 2;
+    std::memset(tail, 0, tail_blocks * SHA256_BLOCK_SIZE);
+    std::memcpy(tail, rest, rest_size);
+    tail[rest_size] = 0x80;
+    uint64_t bits = (uint64_t) size * 8;
+    for (int i = 0; i < 8; ++i) {
+        tail[tail_blocks * SHA256_BLOCK_SIZE - 1 - i] = (uint8_t) (bits >> (8 * i));
+    }
+    return tail_blocks;
+}
+
+/*
+ * Incremental SHA-256: update() with any pieces, then finalize() once.
+ * Whole blocks go straight from the input to the compression function, only partial blocks are buffered.
+ */
+class Sha256 {
+public:
+    Sha256() {
+        std::memcpy(state_, SHA256_INITIAL_STATE, sizeof(state_));
+    }
+
+    void update(const void *data, size_t size) {
+        const uint8_t *bytes = (const uint8_t *) data;
+        total_size_ += size;
+        if (buffered_ > 0) {
+            size_t take = std::min(size, SHA256_BLOCK_SIZE - buffered_);
+            std::memcpy(buffer_ + buffered_, bytes, take);
+            buffered_ += take;
+            bytes += take;
+            size -= take;
+            if (buffered_ < SHA256_BLOCK_SIZE) {
+                return;
+            }
+            sha256Compress(state_, buffer_, 1);
+            buffered_ = 0;
+        }
+        sha256Compress(state_, bytes, size / SHA256_BLOCK_SIZE);
+        buffered_ = size % SHA256_BLOCK_SIZE;
+        std::memcpy(buffer_, bytes + size - buffered_, buffered_);
+    }
+
+    Sha256Digest finalize() {
+        uint8_t tail[2 * SHA256_BLOCK_SIZE];
+        size_t tail_blocks = sha256Tail(buffer_, total_size_, tail); // buffered bytes are the last total % 64
+        sha256Compress(state_, tail, tail_blocks);
+        Sha256Digest res;
+        for (int i = 0; i < 8; ++i) {
+            storeBigEndian32(res.data() + 4 * i, state_[i]);
+        }
+        return res;
+    }
+
+    static Sha256Digest digest(const void *data, size_t size) {
+        Sha256 sha;
+        sha.update(data, size);
+        return sha.finalize();
+    }
+
+private:
+    uint32_t state_[8];
+    uint8_t buffer_[SHA256_BLOCK_SIZE];
+    size_t buffered_ = 0;
+    uint64_t total_size_ = 0;
+};
+
+/*
+ * HMAC-SHA-256 (RFC 2104). The key is absorbed once into an inner and an outer state,
+ * every message then starts from copies of them, so one object tags any number of messages.
+ */
+class HmacSha256 {
+public:
+    HmacSha256(const void *key, size_t size) {
+        uint8_t block[SHA256_BLOCK_SIZE] = {};
+        if (size > SHA256_BLOCK_SIZE) {
+            Sha256Digest key_digest = Sha256::digest(key, size);
+            std::memcpy(block, key_digest.data(), key_digest.size());
+        } else {
+            std::memcpy(block, key, size);
+        }
+        uint8_t pad[SHA256_BLOCK_SIZE];
+        for (size_t i = 0; i < SHA256_BLOCK_SIZE; ++i) {
+            pad[i] = block[i] ^ 0x36;
+        }
+        inner_key_.update(pad, sizeof(pad));
+        for (size_t i = 0; i < SHA256_BLOCK_SIZE; ++i) {
+            pad[i] = block[i] ^ 0x5c;
+        }
+        outer_key_.update(pad, sizeof(pad));
+        inner_ = inner_key_;
+    }
+
+    void update(const void *data, size_t size) {
+        inner_.update(data, size);
+    }
+
+    // tag of everything since the previous finalize()
+    Sha256Digest finalize() {
+        Sha256Digest inner_digest = inner_.finalize();
+        Sha256 outer = outer_key_;
+        outer.update(inner_digest.data(), inner_digest.size());
+        inner_ = inner_key_;
+        return outer.finalize();
+    }
+
+private:
+    Sha256 inner_key_;
+    Sha256 outer_key_;
+    Sha256 inner_;
+};
+
+#ifdef X86_DISPATCH
+
+// 8 messages of the same size at once, one per lane
+__attribute__((target("avx2")))
+inline void sha256BatchAvx2(const uint8_t *const *messages, size_t size, Sha256Digest *digests) {
+    __m256i state[8];
+    for (int i = 0; i < 8; ++i) {
+        state[i] = _mm256_set1_epi32((int) SHA256_INITIAL_STATE[i]);
+    }
+
+    const uint8_t *blocks[SHA256_AVX2_LANES];
+    for (size_t offset = 0; offset + SHA256_BLOCK_SIZE <= size; offset += SHA256_BLOCK_SIZE) {
+        for (size_t lane = 0; lane < SHA256_AVX2_LANES; ++lane) {
+            blocks[lane] = messages[lane] + offset;
+        }
+        sha256CompressAvx2x8(state, blocks);
+    }
+
+    uint8_t tails[SHA256_AVX2_LANES][2 * SHA256_BLOCK_SIZE];
+    size_t tail_blocks = 0;
+    for (size_t lane = 0; lane < SHA256_AVX2_LANES; ++lane) {
+        tail_blocks = sha256Tail(messages[lane] + size - size % SHA256_BLOCK_SIZE, size, tails[lane]);
+    }
+    for (size_t k = 0; k < tail_blocks; ++k) {
+        for (size_t lane = 0; lane < SHA256_AVX2_LANES; ++lane) {
+            blocks[lane] = tails[lane] + k * SHA256_BLOCK_SIZE;
+        }
+        sha256CompressAvx2x8(state, blocks);
+    }
+
+    alignas(32) uint32_t words[8][SHA256_AVX2_LANES];
+    for (int i = 0; i < 8; ++i) {
+        _mm256_store_si256((__m256i *) words[i], state[i]);
+    }
+    for (size_t lane = 0; lane < SHA256_AVX2_LANES; ++lane) {
+        for (int i = 0; i < 8; ++i) {
+            storeBigEndian32(digests[lane].data() + 4 * i, words[i][lane]);
+        }
+    }
+}
+
+#endif
+
+/*
+ * Digests of count messages that all have the same size, e.g. the chunks of a hash tree.
+ * SHA-NI hashes them one after another, without it AVX2 hashes 8 at a time in vector lanes.
+ */
+inline void sha256Batch(const uint8_t *const *messages, size_t size, size_t count, Sha256Digest *digests) {
+    size_t i = 0;
+#ifdef X86_DISPATCH
+    if (!hasShaNi() && hasAvx2()) {
+        for (; i + SHA256_AVX2_LANES <= count; i += SHA256_AVX2_LANES) {
+            sha256BatchAvx2(messages + i, size, digests + i);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        digests[i] = Sha256::digest(messages[i], size);
+    }
+}
+
+inline std::string toHex(const Sha256Digest &digest) {
+    static const char *digits = "0123456789abcdef";
+    std::string res;
+    for (uint8_t byte: digest) {
+        res += digits[byte >> 4];
+        res += digits[byte & 15];
+    }
+    return res;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "functions.h"
+
+/*
+ * Set of spent banknote numbers: open addressing with linear probing, and a blocked Bloom filter in front of it.
+ * Every Bloom lookup touches a single 64-bit word, so a fresh note is usually rejected without probing the table.
+ * The table doubles once size exceeds capacity * max load factor, reserve() avoids rehashing when the size is known.
+ */
+class SpentNoteIndex {
+public:
+    static constexpr double DEFAULT_MAX_LOAD_FACTOR = 0.5;
+    // linear probing needs an empty slot to stop at, and reserve() needs a positive factor to stop doubling
+    static constexpr double MIN_LOAD_FACTOR = 0.05;
+    static constexpr double MAX_LOAD_FACTOR = 0.95;
+    static constexpr size_t BLOOM_BITS_PER_SLOT = 8;
+
+    explicit SpentNoteIndex(size_t expected_size = 0) {
+        reserve(expected_size);
+    }
+
+    bool contains(uint64_t note) const {
+        if (note == EMPTY) {
+            return has_empty_key_;
+        }
+        uint64_t hash = mixHash(note);
+        if (!bloomMayContain(hash)) {
+            return false;
+        }
+        return slots_[findSlot(note, hash)] == note;
+    }
+
+    // false if the note was already spent
+    bool insert(uint64_t note) {
+        if (note == EMPTY) {
+            bool inserted = !has_empty_key_;
+            has_empty_key_ = true;
+            size_ += inserted;
+            return inserted;
+        }
+        if ((double) (size_ + 1) > (double) slots_.size() * max_load_factor_) {
+            rehash(slots_.size() * 2);
+        }
+
+        uint64_t hash = mixHash(note);
+        size_t slot = findSlot(note, hash);
+        if (slots_[slot] == note) {
+            return false;
+        }
+        slots_[slot] = note;
+        bloomAdd(hash);
+        ++size_;
+        return true;
+    }
+
+    // makes room for count notes without further rehashing
+    void reserve(size_t count) {
+        size_t needed = MIN_CAPACITY;
+        while ((double) count > (double) needed * max_load_factor_) {
+            needed *= 2;
+        }
+        if (needed > slots_.size()) {
+            rehash(needed);
+        }
+    }
+
+    // rebuilds the table and the Bloom filter with the given power-of-two number of slots
+    void rehash(size_t capacity) {
+        std::vector<uint64_t> old_slots = std::move(slots_);
+        slots_.assign(capacity, EMPTY);
+        bloom_.assign(capacity * BLOOM_BITS_PER_SLOT / 64, 0);
+        for (uint64_t note: old_slots) {
+            if (note != EMPTY) {
+                uint64_t hash = mixHash(note);
+                slots_[findSlot(note, hash)] = note;
+                bloomAdd(hash);
+            }
+        }
+    }
+
+    // clamped to [MIN_LOAD_FACTOR, MAX_LOAD_FACTOR]
+    void setMaxLoadFactor(double max_load_factor) {
+        assert(!std::isnan(max_load_factor));
+        max_load_factor_ = std::clamp(max_load_factor, MIN_LOAD_FACTOR, MAX_LOAD_FACTOR);
+        reserve(size_);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    size_t capacity() const {
+        return slots_.size();
+    }
+
+    // bytes held by the table and the Bloom filter
+    size_t memoryUsage() const {
+        return slots_.capacity() * sizeof(uint64_t) + bloom_.capacity() * sizeof(uint64_t);
+    }
+
+    // calls f(note) for every spent note in table order
+    template<typename F>
+    void forEach(F f) const {
+        if (has_empty_key_) {
+            f(EMPTY);
+        }
+        for (uint64_t note: slots_) {
+            if (note != EMPTY) {
+                f(note);
+            }
+        }
+    }
+
+private:
+    static constexpr uint64_t EMPTY = 0; // note 0 is tracked by has_empty_key_ instead of a slot
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    std::vector<uint64_t> slots_;
+    std::vector<uint64_t> bloom_;
+    size_t size_ = 0;
+    bool has_empty_key_ = false;
+    double max_load_factor_ = DEFAULT_MAX_LOAD_FACTOR;
+
+    // slot holding the note or the empty slot where it would go
+    size_t findSlot(uint64_t note, uint64_t hash) const {
+        size_t mask = slots_.size() - 1;
+        size_t slot = hash & mask;
+        while (slots_[slot] != EMPTY && slots_[slot] != note) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    // the word is picked by the high bits of the hash, three bits inside it by three 6-bit fields
+    uint64_t bloomMask(uint64_t hash) const {
+        return ((uint64_t) 1 << (hash & 63)) | ((uint64_t) 1 << ((hash >> 6) & 63))
+               | ((uint64_t) 1 << ((hash >> 12) & 63));
+    }
+
+    size_t bloomWord(uint64_t hash) const {
+        return (hash >> 32) & (bloom_.size() - 1);
+    }
+
+    bool bloomMayContain(uint64_t hash) const {
+        uint64_t mask = bloomMask(hash);
+        return (bloom_[bloomWord(hash)] & mask) == mask;
+    }
+
+    void bloomAdd(uint64_t hash) {
+        bloom_[bloomWord(hash)] |= bloomMask(hash);
+    }
+};
+
+/*
+ * SpentNoteIndex split into shards by hash, each behind its own mutex, so deposits from
+ * different threads rarely wait for each other. Shards sit on separate cache lines.
+ */
+class ConcurrentSpentNoteIndex {
+public:
+    static constexpr size_t SHARDS = 64; // mixHash(note) >> 58 picks one
+
+    explicit ConcurrentSpentNoteIndex(size_t expected_size = 0) {
+        for (Shard &shard: shards_) {
+            shard.index.reserve(expected_size / SHARDS);
+        }
+    }
+
+    bool contains(uint64_t note) const {
+        const Shard &shard = shardOf(note);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.index.contains(note);
+    }
+
+    // false if the note was already spent
+    bool insert(uint64_t note) {
+        Shard &shard = shardOf(note);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.index.insert(note);
+    }
+
+    size_t size() const {
+        size_t res = 0;
+        for (const Shard &shard: shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            res += shard.index.size();
+        }
+        return res;
+    }
+
+    size_t memoryUsage() const {
+        size_t res = sizeof(shards_);
+        for (const Shard &shard: shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            res += shard.index.memoryUsage();
+        }
+        return res;
+    }
+
+    // shards are locked one at a time, so notes inserted meanwhile may or may not be visited
+    template<typename F>
+    void forEach(F f) const {
+        for (const Shard &shard: shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.index.forEach(f);
+        }
+    }
+
+private:
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        SpentNoteIndex index;
+    };
+
+    std::array<Shard, SHARDS> shards_;
+
+    // top bits pick the shard, the low bits stay independent for the slot inside it
+    const Shard &shardOf(uint64_t note) const {
+        return shards_[mixHash(note) >> 58];
+    }
+
+    Shard &shardOf(uint64_t note) {
+        return shards_[mixHash(note) >> 58];
+    }
+};
@@ -1,7 +1,12 @@
+#include <atomic>
+#include <fstream>
 #include <iostream>
-#include <unordered_map>
+#include <vector>
+#include "BabyStepGiantStep.h"
 #include "InputParser.h"
 #include "ModularArithmetic.h"
+#include "Parallel.h"
+#include "PohligHellman.h"
 
 const uint64_t DEFAULT_P = 30803;
 const uint64_t DEFAULT_G = 2;
@@ -10,14 +15,32 @@ struct Args {
     uint64_t p;
     uint64_t g;
     uint64_t x;
+    uint64_t threads;
+    bool pohlig_hellman;
+    bool batch;
+    std::string batch_file;
+    uint64_t table_size;
 };
 
 Args parseArgs(int argc, char **argv) {
-    Args args = {.p=DEFAULT_P, .g=DEFAULT_G, .x=0};
+    Args args = {.p=DEFAULT_P, .g=DEFAULT_G, .x=0, .threads=defaultThreadCount(), .pohlig_hellman=false,
+            .batch=false, .batch_file="", .table_size=0};
     InputParser input(argc, argv);
     input.parseOption("-p", args.p);
     input.parseOption("-g", args.g);
     input.parseOption("-x", args.x);
+    input.parseOption("-t", args.threads);
+    args.pohlig_hellman = input.isOptionExists("-ph");
+    args.batch = input.isOptionExists("-batch");
+    args.batch_file = input.getOption("-f");
+    input.parseOption("-n", args.table_size);
+    if (args.p < 3) {
+        std::cerr << "Modulus must be an odd prime" << std::endl;
+        exit(1);
+    }
+    if (args.batch) {
+        return args;
+    }
     if (args.x == 0) {
         std::cerr << "Exponent is required, use -x [exp]" << std::endl;
         exit(1);
@@ -29,8 +52,86 @@ Args parseArgs(int argc, char **argv) {
     return args;
 }
 
+/*
+ * Batch mode: one table of g^i is built and shared by every target y read from the input.
+ * A larger table (-n) means fewer giant steps per target, targets are spread over the threads.
+ */
+void crackBatch(const Args &args, const ModularArithmetic &ma) {
+    std::vector<uint64_t> targets;
+    std::ifstream file;
+    if (!args.batch_file.empty()) {
+        file.open(args.batch_file);
+        if (!file) {
+            std::cerr << "Cannot open " << args.batch_file << std::endl;
+            exit(1);
+        }
+    }
+    std::istream &input = args.batch_file.empty() ? std::cin : file;
+    for (uint64_t y; input >> y;) {
+        targets.push_back(y);
+    }
+
+    uint64_t p = args.p;
+    uint64_t g = args.g;
+    uint64_t n = args.table_size != 0 ? args.table_size : (uint64_t) ceil(sqrt(p));
+    uint64_t giant_steps = (p + n - 1) / n;
+    std::cout << "p = " << p << std::endl;
+    std::cout << "g = " << g << std::endl;
+    std::cout << "targets = " << targets.size() << std::endl;
+    std::cout << "table size = " << n << ", giant steps = " << giant_steps << std::endl;
+    std::cout << "threads = " << args.threads << std::endl;
+
+    std::cout << "----- Cracking -----" << std::endl;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    BabyStepTable baby_steps(ma, g, n, args.threads);
+    auto table_time = std::chrono::high_resolution_clock::now();
+    std::cout << "Table built in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(table_time - start_time).count() << " ms"
+              << std::endl;
+
+    std::vector<uint64_t> exponents(targets.size());
+    std::vector<bool> cracked(targets.size());
+    std::vector<int64_t> micros(targets.size());
+    std::atomic<size_t> next_target{0};
+    runThreads(args.threads, [&](unsigned) {
+        for (size_t k = next_target++; k < targets.size(); k = next_target++) {
+            auto target_start = std::chrono::high_resolution_clock::now();
+            uint64_t exponent;
+            bool found = babyStepGiantStep(ma, baby_steps, g, targets[k], giant_steps, 1, exponent);
+            auto target_end = std::chrono::high_resolution_clock::now();
+            exponents[k] = exponent;
+            cracked[k] = found;
+            micros[k] = std::chrono::duration_cast<std::chrono::microseconds>(target_end - target_start).count();
+        }
+    });
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    size_t cracked_count = 0;
+    for (size_t k = 0; k < targets.size(); ++k) {
+        std::cout << "y = " << targets[k];
+        if (cracked[k]) {
+            ++cracked_count;
+            std::cout << " exponent was " << exponents[k];
+        } else {
+            std::cout << " not found";
+        }
+        std::cout << " (" << micros[k] << " us)" << std::endl;
+    }
+
+    auto total_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+    auto giant_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - table_time).count();
+    std::cout << "Cracked " << cracked_count << " of " << targets.size() << " in " << total_ms << " ms, "
+              << (double) targets.size() * 1000 / (double) std::max<int64_t>(giant_ms, 1)
+              << " targets/s after the table" << std::endl;
+}
+
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
+    if (args.batch) {
+        crackBatch(args, ModularArithmetic(args.p));
+        return 0;
+    }
     std::cout << "Parameters:\n";
 
     ModularArithmetic ma(args.p);
@@ -50,29 +151,35 @@ int main(int argc, char **argv) {
 
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    uint64_t n = (uint64_t) ceil(sqrt(p));
-    std::cout << "n = m = " << n << std::endl;
+    uint64_t exponent;
+    bool cracked;
+    if (args.pohlig_hellman) {
+        PohligHellman pohlig_hellman(p, g, args.threads);
+        std::cout << "p - 1 =";
+        for (auto [q, e]: pohlig_hellman.factors()) {
+            std::cout << " " << q << "^" << e;
+        }
+        std::cout << std::endl;
+        if (pohlig_hellman.largestFactor() < (p - 1) / 2) {
+            std::cout << "Warning: p is not a safe prime, the cost is about sqrt("
+                      << pohlig_hellman.largestFactor() << ") instead of sqrt(p)" << std::endl;
+        }
+        std::cout << "threads = " << args.threads << std::endl;
+
+        cracked = pohlig_hellman.solve(y, exponent);
+    } else {
+        uint64_t n = (uint64_t) ceil(sqrt(p));
+        std::cout << "n = m = " << n << std::endl;
+        std::cout << "threads = " << args.threads << std::endl;
 
-    std::unordered_map<uint64_t, uint64_t> baby_steps;
-    uint64_t baby_step = y;
-    baby_steps.emplace(baby_step, 0);
-    for (uint64_t i = 1; i < n; i++) {
-        baby_step = ma.mul(baby_step, g); // y * g^i
-        baby_steps.emplace(baby_step, i);
+        BabyStepTable baby_steps(ma, g, n, args.threads);
+        cracked = babyStepGiantStep(ma, baby_steps, g, y, n, args.threads, exponent);
     }
 
-    uint64_t start_giant_step = ma.pow(g, n);
-    uint64_t giant_step = start_giant_step;
-    for (uint64_t j = 1; j < n; j++) {
-        if (baby_steps.find(giant_step) != baby_steps.end()) {
-            uint64_t i = baby_steps[giant_step];
-            uint64_t exponent = j * n - i;
-            auto end_time = std::chrono::high_resolution_clock::now();
-            std::cout << "Cracked in "
-                      << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms!"
-                      << " exponent was " << exponent << std::endl;
-            break;
-        }
-        giant_step = ma.mul(giant_step, start_giant_step); // g^(j*n)
+    if (cracked) {
+        auto end_time = std::chrono::high_resolution_clock::now();
+        std::cout << "Cracked in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms!"
+                  << " exponent was " << exponent << std::endl;
     }
 }
\ No newline at end of file
@@ -1,87 +1,239 @@
+#include <chrono>
 #include <iostream>
+#include <random>
+#include <vector>
+#include "BatchExponentiation.h"
+#include "ElGamal.h"
 #include "InputParser.h"
 #include "functions.h"
 #include "Randomizer.h"
 #include "ModularArithmetic.h"
 
 const int DEFAULT_SEED = 123;
-constexpr uint64_t Q_MAX = UINT64_MAX / 2 - 2;
+const uint64_t DEFAULT_BATCH_SIZE = 1024;
 
 struct Args {
     uint64_t seed;
+    uint64_t flips;   // tournament mode: number of flips under one parameter set
+    uint64_t players; // tournament mode: single-elimination bracket, one flip per match
+    uint64_t batch;
 };
 
 Args parseArgs(int argc, char **argv) {
-    Args args = {.seed=DEFAULT_SEED};
+    Args args = {.seed=DEFAULT_SEED, .flips=0, .players=0, .batch=DEFAULT_BATCH_SIZE};
     InputParser input(argc, argv);
     input.parseOption("-s", args.seed);
+    input.parseOption("-n", args.flips);
+    input.parseOption("-players", args.players);
+    input.parseOption("-batch", args.batch);
+    args.batch = std::max<uint64_t>(args.batch, 1);
     return args;
 }
 
-struct ElGamalParams {
-    uint64_t modulus;
-    uint64_t base;
+/*
+ * Алгоритм подбрасывания монетки (взят из книги "Введение в криптографию" Ященко):
+ * 1. Алиса генерирует ключи по схеме Эль-Гамаля и отправляет публичный ключ Бобу
+ * 2. Боб генерирует ключи по схеме Эль-Гамаля и случайный бит 'b', и отравляет Алисе r = (y_a)^b * y_b (mod P)
+ * 3. Алиса генерирует случайный бит 'a' и отправляет его Бобу
+ * 4. Боб отправляет Алисе ранее сгенерированные бит 'b' и свой секретный ключ x_b
+ * 5. Алиса проверяет, что  r = (y_a)^b * y_b = (y_a)^b * (g)^x_b (mod P)
+ * 6. Если все правильно, то результат подбрасывания монетки = a XOR b
+ */
 
-    static ElGamalParams generate(Randomizer &randomizer) {
-        ElGamalParams params;
-        uint64_t prime_factor;
-        do {
-            prime_factor = randomizer.randomPrime(UINT16_MAX, Q_MAX);
-            params.modulus = 2 * prime_factor + 1;
-        } while (!isPrime(params.modulus));
+/*
+ * Tournament mode: many flips under one set of parameters and one Alice key. Bob still picks a fresh 'b' and
+ * Alice checks a revealed batch at once: for random 32-bit weights c_i, drawn from the system and not the seed,
+ *     prod r_i^c_i = (y_a)^(sum c_i * b_i) * g^(sum c_i * x_b_i) (mod P),
+ * which a wrong r_i fails with probability about 2^-32. The weights cannot see a wrong sign (the order 2
+ * part of the group), so the Jacobi symbol of every r_i is checked separately. If the batch fails, every
+ * flip is checked alone to find the cheat.
+ */
+struct FlipBatch {
+    std::vector<uint64_t> b;
+    std::vector<uint64_t> private_keys;
+    std::vector<uint64_t> commitments;
+    std::vector<uint64_t> a;
+};
 
-        ModularArithmetic ma(params.modulus);
-        do {
-            params.base = randomizer.random(2, params.modulus - 2);
-        } while (ma.pow(params.base, prime_factor) == 1);
+struct TournamentStats {
+    uint64_t flips = 0;
+    double commit_seconds = 0;
+    double verify_seconds = 0;
+};
 
-        return params;
+class CoinFlipper {
+public:
+    CoinFlipper(const ElGamalParams &params, const ElGamalKey &alice_key, Randomizer &randomizer, uint64_t batch)
+            : params_(params), alice_key_(alice_key), randomizer_(randomizer), batch_(batch), ma_(params.modulus),
+              base_pow_(ma_, params.base) {}
+
+    // 'count' flips, the result bits in order; exits if Bob cheats
+    std::vector<uint64_t> flip(uint64_t count) {
+        std::vector<uint64_t> res;
+        for (uint64_t done = 0; done < count; done += batch_) {
+            FlipBatch batch;
+            uint64_t size = std::min(batch_, count - done);
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+            commit(batch, size); // Bob sends r_i
+            auto commit_time = std::chrono::high_resolution_clock::now();
+            for (uint64_t i = 0; i < size; ++i) {
+                batch.a.push_back(randomizer_.random(0, 1)); // Alice sends a_i, Bob reveals b_i and x_b_i
+            }
+            auto reveal_time = std::chrono::high_resolution_clock::now();
+            uint64_t cheat = verify(batch);
+            auto end_time = std::chrono::high_resolution_clock::now();
+
+            stats_.flips += size;
+            stats_.commit_seconds += std::chrono::duration<double>(commit_time - start_time).count();
+            stats_.verify_seconds += std::chrono::duration<double>(end_time - reveal_time).count();
+            if (cheat < size) {
+                std::cout << "Bob trying to cheat in flip " << done + cheat + 1 << "!" << std::endl;
+                exit(1);
+            }
+            for (uint64_t i = 0; i < size; ++i) {
+                res.push_back(batch.a[i] ^ batch.b[i]);
+            }
+        }
+        return res;
     }
 
-    void print() {
-        std::cout << "modulus = " << modulus << std::endl;
-        std::cout << "base = " << base << std::endl;
+    void printStats() const {
+        std::cout << "Flips = " << stats_.flips << ", batch size = " << batch_ << std::endl;
+        std::cout << "Commitments: " << (uint64_t) ((double) stats_.flips / std::max(stats_.commit_seconds, 1e-9))
+                  << " /s" << std::endl;
+        std::cout << "Verifications: " << (uint64_t) ((double) stats_.flips / std::max(stats_.verify_seconds, 1e-9))
+                  << " /s" << std::endl;
     }
-};
 
-struct ElGamalKey {
-    uint64_t private_key;
-    uint64_t public_key;
+private:
+    const ElGamalParams &params_;
+    const ElGamalKey &alice_key_;
+    Randomizer &randomizer_;
+    uint64_t batch_;
+    ModularArithmetic ma_;
+    FixedBasePow base_pow_; // g^x for Bob's fresh keys
+    TournamentStats stats_;
+    std::random_device weight_source_; // batch weights must be unpredictable to whoever knows the seed
+
+    // r_i = (y_a)^b_i * y_b_i = (y_a)^b_i * g^x_b_i (mod P)
+    void commit(FlipBatch &batch, uint64_t size) {
+        for (uint64_t i = 0; i < size; ++i) {
+            batch.b.push_back(randomizer_.random(0, 1));
+            batch.private_keys.push_back(randomizer_.random(2, params_.modulus - 2));
+        }
+        batch.commitments = base_pow_.pow(batch.private_keys);
+        for (uint64_t i = 0; i < size; ++i) {
+            if (batch.b[i] == 1) {
+                batch.commitments[i] = ma_.mul(batch.commitments[i], alice_key_.public_key);
+            }
+        }
+    }
 
-    static ElGamalKey generate(const ElGamalParams &params, Randomizer &randomizer) {
-        ElGamalKey key;
-        ModularArithmetic ma(params.modulus);
+    // index of the first flip with a wrong commitment, or the batch size if all are right
+    uint64_t verify(const FlipBatch &batch) {
+        uint64_t size = batch.commitments.size();
+        int alice_symbol = jacobi(alice_key_.public_key, params_.modulus);
+        for (uint64_t i = 0; i < size; ++i) {
+            int expected = (batch.b[i] == 1 ? alice_symbol : 1) * (batch.private_keys[i] % 2 == 1 ? -1 : 1);
+            if (jacobi(batch.commitments[i], params_.modulus) != expected) {
+                return findCheat(batch);
+            }
+        }
+
+        ModularArithmetic order(params_.modulus - 1);
+        std::vector<uint64_t> weights(size);
+        std::uniform_int_distribution<uint64_t> weight_distribution(1, UINT32_MAX);
+        uint64_t alice_exponent = 0;
+        uint64_t base_exponent = 0;
+        for (uint64_t i = 0; i < size; ++i) {
+            weights[i] = weight_distribution(weight_source_);
+            alice_exponent = order.add(alice_exponent, weights[i] * batch.b[i]);
+            base_exponent = order.add(base_exponent, order.mul(weights[i], batch.private_keys[i]));
+        }
+        if (ma_.multiPow(batch.commitments, weights) ==
+            ma_.multiPow({alice_key_.public_key, params_.base}, {alice_exponent, base_exponent})) {
+            return size;
+        }
+        return findCheat(batch);
+    }
 
-        key.private_key = randomizer.random(2, params.modulus - 2);
-        key.public_key = ma.pow(params.base, key.private_key);
+    uint64_t findCheat(const FlipBatch &batch) const {
+        uint64_t size = batch.commitments.size();
+        for (uint64_t i = 0; i < size; ++i) {
+            if (batch.commitments[i] != ma_.multiPow({alice_key_.public_key, params_.base},
+                                                     {batch.b[i], batch.private_keys[i]})) {
+                return i;
+            }
+        }
+        return size;
+    }
+};
 
-        return key;
+void runFlips(const Args &args, CoinFlipper &flipper) {
+    std::vector<uint64_t> results = flipper.flip(args.flips);
+    for (uint64_t i = 0; i < results.size(); ++i) {
+        std::cout << "Flip " << i + 1 << ": " << results[i] << std::endl;
     }
+}
 
-    void print() {
-        std::cout << "private key = " << private_key << std::endl;
-        std::cout << "public key = " << public_key << std::endl;
+// single elimination, the first player of a match wins on 0; with an odd count the last player has a bye
+void runBracket(const Args &args, CoinFlipper &flipper) {
+    std::vector<uint64_t> players(args.players);
+    for (uint64_t i = 0; i < players.size(); ++i) {
+        players[i] = i + 1;
     }
-};
+    for (uint64_t round = 1; players.size() > 1; ++round) {
+        std::vector<uint64_t> results = flipper.flip(players.size() / 2);
+        std::vector<uint64_t> winners;
+        for (uint64_t j = 0; j < results.size(); ++j) {
+            uint64_t first = players[2 * j], second = players[2 * j + 1];
+            winners.push_back(results[j] == 0 ? first : second);
+            std::cout << "Round " << round << " match " << j + 1 << ": P" << first << " vs P" << second << " -> P"
+                      << winners.back() << std::endl;
+        }
+        if (players.size() % 2 == 1) {
+            winners.push_back(players.back());
+            std::cout << "Round " << round << ": P" << players.back() << " advances" << std::endl;
+        }
+        players = std::move(winners);
+    }
+    if (!players.empty()) {
+        std::cout << "Winner: P" << players[0] << std::endl;
+    }
+}
 
-/*
- * Алгоритм подбрасывания монетки (взят из книги "Введение в криптографию" Ященко):
- * 1. Алиса генерирует ключи по схеме Эль-Гамаля и отправляет публичный ключ Бобу
- * 2. Боб генерирует ключи по схеме Эль-Гамаля и случайный бит 'b', и отравляет Алисе r = (y_a)^b * y_b (mod P)
- * 3. Алиса генерирует случайный бит 'a' и отправляет его Бобу
- * 4. Боб отправляет Алисе ранее сгенерированные бит 'b' и свой секретный ключ x_b
- * 5. Алиса проверяет, что  r = (y_a)^b * y_b = (y_a)^b * (g)^x_b (mod P)
- * 6. Если все правильно, то результат подбрасывания монетки = a XOR b
- */
+void runTournament(const Args &args, Randomizer &randomizer) {
+    std::cout << "----- SETUP -----" << std::endl;
+    ElGamalParams params = ElGamalParams::generate(randomizer, UINT16_MAX);
+    params.print();
+    ElGamalKey alice_key = ElGamalKey::generate(params, randomizer);
+    std::cout << "Alice public key = " << alice_key.public_key << std::endl;
+
+    CoinFlipper flipper(params, alice_key, randomizer, args.batch);
+    std::cout << "----- FLIPS -----" << std::endl;
+    if (args.players > 0) {
+        runBracket(args, flipper);
+    } else {
+        runFlips(args, flipper);
+    }
+    std::cout << "----- STATS -----" << std::endl;
+    flipper.printStats();
+}
 
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
     Randomizer randomizer(args.seed);
     std::cout << "Randomizer seed = " << args.seed << std::endl;
 
+    if (args.flips > 0 || args.players > 0) {
+        runTournament(args, randomizer);
+        return 0;
+    }
+
     std::cout << "----- STEP 0 -----" << std::endl;
 
-    ElGamalParams params = ElGamalParams::generate(randomizer);
+    ElGamalParams params = ElGamalParams::generate(randomizer, UINT16_MAX);
     std::cout << "ElGamal parameters:" << std::endl;
     params.print();
 
@@ -118,8 +270,8 @@ int main(int argc, char **argv) {
 
     std::cout << "----- STEP 5 -----" << std::endl;
 
-    uint64_t r_check = ma.mul(ma.pow(alice_key.public_key, b),
-                              ma.pow(params.base, bob_key.private_key)); // (y_a)^b * (g)^x_b (mod P)
+    uint64_t r_check = ma.multiPow({alice_key.public_key, params.base},
+                                   {b, bob_key.private_key}); // (y_a)^b * (g)^x_b (mod P)
     if (r != r_check) {
         std::cout << "Bob trying to cheat!" << std::endl;
         return 1;
@@ -1,5 +1,7 @@
+#include <chrono>
 #include <iostream>
 #include <cstdint>
+#include "ElGamal.h"
 #include "InputParser.h"
 #include "ModularArithmetic.h"
 #include "Randomizer.h"
@@ -14,6 +16,7 @@ struct Args {
     uint64_t public_modulus;
     uint64_t private_key_a;
     uint64_t private_key_b;
+    uint64_t bits;
 };
 
 Args parseArgs(int argc, char **argv) {
@@ -22,7 +25,8 @@ Args parseArgs(int argc, char **argv) {
             .public_base=DEFAULT_PUBLIC_BASE,
             .public_modulus=DEFAULT_PUBLIC_MODULUS,
             .private_key_a=0,
-            .private_key_b=0
+            .private_key_b=0,
+            .bits=0
     };
 
     InputParser input(argc, argv);
@@ -31,25 +35,72 @@ Args parseArgs(int argc, char **argv) {
     input.parseOption("-g", args.public_base);
     input.parseOption("-xa", args.private_key_a);
     input.parseOption("-xb", args.private_key_b);
+    // large group mode: -bits 2048 or 3072, the RFC 3526 group of that size with BigInt keys
+    input.parseOption("-bits", args.bits);
 
     return args;
 }
 
-uint64_t derivePublicKey(uint64_t private_key, uint64_t public_base, uint64_t public_modulus) {
-    ModularArithmetic ma(public_modulus);
+// T is uint64_t or BigInt
+template<typename T>
+T derivePublicKey(const T &private_key, const T &public_base, const T &public_modulus) {
+    BasicModularArithmetic<T> ma(public_modulus);
     return ma.pow(public_base, private_key);
 }
 
-uint64_t deriveSharedKey(uint64_t private_key, uint64_t public_key, uint64_t public_modulus) {
-    ModularArithmetic ma(public_modulus);
+template<typename T>
+T deriveSharedKey(const T &private_key, const T &public_key, const T &public_modulus) {
+    BasicModularArithmetic<T> ma(public_modulus);
     return ma.pow(public_key, private_key);
 }
 
+/*
+ * Large group mode: the same exchange in a MODP group, timed. The private keys are full size
+ * and come from the seeded randomizer, so they are reproducible with -s and only fit for the demo.
+ */
+void runLargeGroup(uint64_t bits, Randomizer &randomizer) {
+    BasicElGamalParams<BigInt> params = BasicElGamalParams<BigInt>::modpGroup(bits);
+    std::cout << "Public base (g) = " << params.base << std::endl;
+    std::cout << "Public modulus (p) = " << params.modulus << std::endl;
+
+    std::cout << "----- STEP 1 -----" << std::endl;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    BasicElGamalKey<BigInt> alice_key = BasicElGamalKey<BigInt>::generate(params, randomizer);
+    BasicElGamalKey<BigInt> bob_key = BasicElGamalKey<BigInt>::generate(params, randomizer);
+    auto key_time = std::chrono::high_resolution_clock::now();
+    std::cout << "Alice private key (x_a) = " << alice_key.private_key << std::endl;
+    std::cout << "Bob private key (x_b) = " << bob_key.private_key << std::endl;
+
+    std::cout << "----- STEP 2 -----" << std::endl;
+
+    std::cout << "Alice public key (y_a) = " << alice_key.public_key << std::endl;
+    std::cout << "Bob public key (y_b) = " << bob_key.public_key << std::endl;
+
+    std::cout << "----- STEP 3 -----" << std::endl;
+
+    BigInt alice_shared_key = deriveSharedKey(alice_key.private_key, bob_key.public_key, params.modulus);
+    BigInt bob_shared_key = deriveSharedKey(bob_key.private_key, alice_key.public_key, params.modulus);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::cout << "Alice shared key (s_ab) = " << alice_shared_key << std::endl;
+    std::cout << "Bob shared key (s_ba) = " << bob_shared_key << std::endl;
+
+    std::cout << bits << "-bit key pairs generated in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(key_time - start_time).count()
+              << " ms, shared keys derived in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - key_time).count()
+              << " ms" << std::endl;
+}
+
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
     Randomizer randomizer(args.seed);
 
     std::cout << "Randomizer seed = " << args.seed << std::endl;
+    if (args.bits != 0) {
+        runLargeGroup(args.bits, randomizer);
+        return 0;
+    }
     std::cout << "Public base (g) = " << args.public_base << std::endl;
     std::cout << "Public modulus (p) = " << args.public_modulus << std::endl;
 
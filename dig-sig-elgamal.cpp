@@ -1,74 +1,45 @@
+#include <chrono>
 #include <iostream>
+#include "ElGamal.h"
 #include "InputParser.h"
 #include "functions.h"
+#include "MerkleTree.h"
 #include "Randomizer.h"
 #include "ModularArithmetic.h"
+#include "Parallel.h"
 
 const int DEFAULT_SEED = 321;
-constexpr uint64_t Q_MAX = UINT64_MAX / 2 - 2;
 
 struct Args {
     uint64_t seed;
     std::string message;
+    std::string file;
+    uint64_t threads;
+    uint64_t chunk_size;
+    uint64_t chunk;
 };
 
 Args parseArgs(int argc, char **argv) {
-    Args args = {.seed=DEFAULT_SEED};
+    Args args = {.seed=DEFAULT_SEED, .message="", .file="", .threads=defaultThreadCount(),
+            .chunk_size=MerkleTree::DEFAULT_CHUNK_SIZE, .chunk=0};
 
     InputParser input(argc, argv);
 
     input.parseOption("-s", args.seed);
     args.message = input.getOption("-m");
+    // file mode: -f [file] [-t threads] [-c chunk size] [-k chunk to verify on its own]
+    args.file = input.getOption("-f");
+    input.parseOption("-t", args.threads);
+    input.parseOption("-c", args.chunk_size);
+    input.parseOption("-k", args.chunk);
+    if (args.chunk_size == 0) {
+        std::cerr << "Chunk size must be positive" << std::endl;
+        exit(1);
+    }
 
     return args;
 }
 
-struct ElGamalParams {
-    uint64_t modulus;
-    uint64_t base;
-
-    static ElGamalParams generate(Randomizer &randomizer) {
-        ElGamalParams params;
-        uint64_t prime_factor;
-        do {
-            prime_factor = randomizer.randomPrime(UINT32_MAX, Q_MAX);
-            params.modulus = 2 * prime_factor + 1;
-        } while (!isPrime(params.modulus));
-
-        ModularArithmetic ma(params.modulus);
-        do {
-            params.base = randomizer.random(2, params.modulus - 2);
-        } while (ma.pow(params.base, prime_factor) == 1);
-
-        return params;
-    }
-
-    void print() {
-        std::cout << "modulus = " << modulus << std::endl;
-        std::cout << "base = " << base << std::endl;
-    }
-};
-
-struct ElGamalKey {
-    uint64_t private_key;
-    uint64_t public_key;
-
-    static ElGamalKey generate(const ElGamalParams &params, Randomizer &randomizer) {
-        ElGamalKey key;
-        ModularArithmetic ma(params.modulus);
-
-        key.private_key = randomizer.random(2, params.modulus - 2);
-        key.public_key = ma.pow(params.base, key.private_key);
-
-        return key;
-    }
-
-    void print() {
-        std::cout << "private key = " << private_key << std::endl;
-        std::cout << "public key = " << public_key << std::endl;
-    }
-};
-
 struct SignedMessage {
     std::string message;
     uint64_t r;
@@ -76,21 +47,58 @@ struct SignedMessage {
 
     void print() {
         std::cout << "message = " << message << std::endl;
+        std::cout << "SHA-256(message) = " << toHex(Sha256::digest(message.data(), message.size())) << std::endl;
         std::cout << "Hash(message) = " << hash(message) << std::endl;
         std::cout << "r = " << r << std::endl;
         std::cout << "s = " << s << std::endl;
     }
 };
 
-bool isSignatureValid(const SignedMessage &signed_message, const ElGamalParams &params, uint64_t public_key) {
+// (r, s) for the message hash h
+void signHash(uint64_t h, const ElGamalParams &params, const ElGamalKey &key, Randomizer &randomizer,
+              uint64_t &r, uint64_t &s) {
+    uint64_t signature_private_key = randomizer.randomCoprime(2, params.modulus - 2, params.modulus - 1);
+    r = ModularArithmetic(params.modulus).pow(params.base, signature_private_key);
+
+    ModularArithmetic ma(params.modulus - 1);
+
+    uint64_t u = ma.sub(h, ma.mul(key.private_key, r)); // u = (h(m) - x * r) mod (p-1)
+    s = ma.mul(ma.inv(signature_private_key), u); // s = (k^-1 * u) mod (p-1)
+}
+
+bool isHashSignatureValid(uint64_t h, uint64_t r, uint64_t s, const ElGamalParams &params, uint64_t public_key) {
     ModularArithmetic ma(params.modulus);
-    uint64_t lhs = ma.pow(params.base, hash(signed_message.message)); // g^h(m) mod p
-    uint64_t rhs = ma.mul(ma.pow(public_key, signed_message.r),
-                          ma.pow(signed_message.r, signed_message.s)); // y^r * r^s mod p
+    uint64_t lhs = ma.pow(params.base, h); // g^h(m) mod p
+    uint64_t rhs = ma.multiPow({public_key, r}, {r, s}); // y^r * r^s mod p
 
     return lhs == rhs;
 }
 
+bool isSignatureValid(const SignedMessage &signed_message, const ElGamalParams &params, uint64_t public_key) {
+    return isHashSignatureValid(hash(signed_message.message), signed_message.r, signed_message.s, params, public_key);
+}
+
+// file mode, see MerkleFile: the leading 32 bits of the file digest are signed
+void signFile(const Args &args, const ElGamalParams &params, const ElGamalKey &key, Randomizer &randomizer) {
+    MerkleFile file(args.file, args.chunk_size, args.threads);
+    file.printStats();
+    uint64_t file_hash = loadBigEndian32(file.signedDigest().data());
+    std::cout << "Hash(file) = " << file_hash << std::endl;
+    uint64_t r, s;
+    signHash(file_hash, params, key, randomizer, r, s);
+    std::cout << "r = " << r << std::endl;
+    std::cout << "s = " << s << std::endl;
+
+    std::cout << "----- STEP 2 - Verify signature -----" << std::endl;
+
+    uint64_t chunk_hash = loadBigEndian32(file.chunkDigest(args.chunk).data());
+    if (isHashSignatureValid(chunk_hash, r, s, params, key.public_key)) {
+        std::cout << "Signature is valid\n";
+    } else {
+        std::cout << "Signature is invalid!\n";
+    }
+}
+
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
     Randomizer randomizer(args.seed);
@@ -98,7 +106,7 @@ int main(int argc, char **argv) {
 
     std::cout << "----- STEP 0 -----" << std::endl;
 
-    ElGamalParams params = ElGamalParams::generate(randomizer);
+    ElGamalParams params = ElGamalParams::generate(randomizer, UINT32_MAX);
     std::cout << "ElGamal params:\n";
     params.print();
 
@@ -108,16 +116,14 @@ int main(int argc, char **argv) {
     std::cout << "ElGamal key:\n";
     key.print();
 
+    if (!args.file.empty()) {
+        signFile(args, params, key, randomizer);
+        return 0;
+    }
+
     SignedMessage signed_message;
     signed_message.message = args.message;
-    uint64_t signature_private_key = randomizer.randomCoprime(2, params.modulus - 2, params.modulus - 1);
-    signed_message.r = ModularArithmetic(params.modulus).pow(params.base, signature_private_key);
-
-    ModularArithmetic ma(params.modulus - 1);
-
-    uint64_t u = ma.sub(hash(signed_message.message),
-                        ma.mul(key.private_key, signed_message.r)); // u = (h(m) - x * r) mod (p-1)
-    signed_message.s = ma.mul(ma.inv(signature_private_key), u); // s = (k^-1 * u) mod (p-1)
+    signHash(hash(signed_message.message), params, key, randomizer, signed_message.r, signed_message.s);
 
     std::cout << "Signed message:\n";
     signed_message.print();
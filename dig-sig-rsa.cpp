@@ -1,6 +1,9 @@
+#include <chrono>
 #include <iostream>
 #include "InputParser.h"
 #include "functions.h"
+#include "MerkleTree.h"
+#include "Parallel.h"
 #include "Randomizer.h"
 #include "rsa.h"
 
@@ -9,15 +12,29 @@ const int DEFAULT_SEED = 321;
 struct Args {
     uint64_t seed;
     std::string message;
+    std::string file;
+    uint64_t threads;
+    uint64_t chunk_size;
+    uint64_t chunk;
 };
 
 Args parseArgs(int argc, char **argv) {
-    Args args = {.seed=DEFAULT_SEED};
+    Args args = {.seed=DEFAULT_SEED, .message="", .file="", .threads=defaultThreadCount(),
+            .chunk_size=MerkleTree::DEFAULT_CHUNK_SIZE, .chunk=0};
 
     InputParser input(argc, argv);
 
     input.parseOption("-s", args.seed);
     args.message = input.getOption("-m");
+    // file mode: -f [file] [-t threads] [-c chunk size] [-k chunk to verify on its own]
+    args.file = input.getOption("-f");
+    input.parseOption("-t", args.threads);
+    input.parseOption("-c", args.chunk_size);
+    input.parseOption("-k", args.chunk);
+    if (args.chunk_size == 0) {
+        std::cerr << "Chunk size must be positive" << std::endl;
+        exit(1);
+    }
 
     return args;
 }
@@ -27,6 +44,28 @@ struct SignedMessage {
     uint64_t signature;
 };
 
+// file mode, see MerkleFile: the leading 32 bits of the file digest are signed
+void signFile(const Args &args, const RSAParams &rsa_params) {
+    MerkleFile file(args.file, args.chunk_size, args.threads);
+    file.printStats();
+    uint64_t file_hash = loadBigEndian32(file.signedDigest().data());
+    std::cout << "Hash(file) = " << file_hash << std::endl;
+    uint64_t signature = signMessageRSA(file_hash, rsa_params.private_key, rsa_params.public_modulus);
+    std::cout << "signature = " << signature << std::endl;
+
+    std::cout << "----- STEP 2 -----" << std::endl;
+
+    uint64_t hash_from_signature = getMessageHashRSA(signature, rsa_params.public_key, rsa_params.public_modulus);
+    std::cout << "File hash from signature = " << hash_from_signature << "\n";
+
+    uint64_t chunk_hash = loadBigEndian32(file.chunkDigest(args.chunk).data());
+    if (chunk_hash == hash_from_signature) {
+        std::cout << "Signature is valid\n";
+    } else {
+        std::cout << "Signature is invalid!\n";
+    }
+}
+
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
     Randomizer randomizer(args.seed);
@@ -40,12 +79,19 @@ int main(int argc, char **argv) {
 
     std::cout << "----- STEP 1 -----" << std::endl;
 
+    if (!args.file.empty()) {
+        signFile(args, rsa_params);
+        return 0;
+    }
+
     SignedMessage signed_message;
     signed_message.message = args.message;
     signed_message.signature = signMessageRSA(hash(signed_message.message), rsa_params.private_key,
                                               rsa_params.public_modulus);
 
     std::cout << "Message: " << signed_message.message << std::endl;
+    std::cout << "SHA-256(message) = " << toHex(Sha256::digest(args.message.data(), args.message.size()))
+              << std::endl;
     std::cout << "Hash(message) = " << hash(signed_message.message) << std::endl;
     std::cout << "signature = " << signed_message.signature << std::endl;
 
@@ -1,21 +1,50 @@
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "InputParser.h"
+#include "Ledger.h"
 #include "functions.h"
 #include "Randomizer.h"
 #include "ModularArithmetic.h"
+#include "Parallel.h"
 #include "rsa.h"
+#include "SpentNoteIndex.h"
 
 const int DEFAULT_SEED = 123;
 const uint64_t BANKNOTE_VALUE = 100;
+const size_t LOAD_WITHDRAW_BATCH = 16; // banknotes a load customer withdraws at once
+const uint64_t DEFAULT_LOAD_DEPOSITS = 20000;
+const uint64_t DEFAULT_LOAD_CUSTOMERS = 16;
+const uint64_t DEFAULT_SNAPSHOT_INTERVAL = 100000; // ledger records between snapshots
+
+bool verbose = true; // the load generator turns off per-operation logging
 
 struct Args {
     uint64_t seed;
+    bool load;
+    uint64_t threads;
+    uint64_t deposits;
+    uint64_t customers;
+    std::string ledger_dir;
+    uint64_t snapshot_interval;
 };
 
 Args parseArgs(int argc, char **argv) {
-    Args args = {.seed=DEFAULT_SEED};
+    Args args = {.seed=DEFAULT_SEED, .load=false, .threads=defaultThreadCount(), .deposits=DEFAULT_LOAD_DEPOSITS,
+            .customers=DEFAULT_LOAD_CUSTOMERS, .ledger_dir="", .snapshot_interval=DEFAULT_SNAPSHOT_INTERVAL};
     InputParser input(argc, argv);
     input.parseOption("-signature", args.seed);
+    args.load = input.isOptionExists("-load");
+    input.parseOption("-t", args.threads);
+    input.parseOption("-n", args.deposits);
+    input.parseOption("-c", args.customers);
+    args.ledger_dir = input.getOption("-ledger");
+    input.parseOption("-snapshot", args.snapshot_interval);
     return args;
 }
 
@@ -24,96 +53,265 @@ struct Banknote {
     uint64_t signature;
 };
 
+// Account balances in cache-line-sized slots, so threads updating neighbouring accounts do not share a line.
+// Slots live in fixed segments that never move, lookups need no lock and only account creation takes one.
+class AccountTable {
+public:
+    static constexpr size_t SEGMENT_SIZE = 4096;
+    static constexpr size_t MAX_SEGMENTS = 4096;
+
+    AccountTable() {
+        for (auto &segment: segments_) {
+            segment.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~AccountTable() {
+        for (auto &segment: segments_) {
+            delete[] segment.load();
+        }
+    }
+
+    uint64_t create(uint64_t initial_value) {
+        std::lock_guard<std::mutex> lock(create_mutex_);
+        size_t number = size_.load(std::memory_order_relaxed);
+        assert(number < SEGMENT_SIZE * MAX_SEGMENTS);
+        if (number % SEGMENT_SIZE == 0) {
+            segments_[number / SEGMENT_SIZE].store(new Slot[SEGMENT_SIZE], std::memory_order_release);
+        }
+        slot(number).value.store(initial_value, std::memory_order_relaxed);
+        size_.store(number + 1, std::memory_order_release);
+        return number;
+    }
+
+    size_t size() const {
+        return size_.load(std::memory_order_acquire);
+    }
+
+    std::atomic<uint64_t> &operator[](size_t number) {
+        assert(number < size()); // проверка на то, что счет существует
+        return slot(number).value;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> value{0};
+    };
+
+    std::array<std::atomic<Slot *>, MAX_SEGMENTS> segments_;
+    std::atomic<size_t> size_{0};
+    std::mutex create_mutex_;
+
+    Slot &slot(size_t number) {
+        return segments_[number / SEGMENT_SIZE].load(std::memory_order_acquire)[number % SEGMENT_SIZE];
+    }
+};
+
+// Thread-safe: balances change with atomic operations and spent notes go to a sharded index.
+// With a ledger every change is durable before the call returns and the state survives restarts.
 class Bank {
 public:
     RSAParams rsa_params;
 
-    Bank(Randomizer &randomizer) : rsa_params(RSAParams::generate(randomizer)) {
+    Bank(Randomizer &randomizer, Ledger *ledger = nullptr)
+            : rsa_params(RSAParams::generate(randomizer)), private_key_(rsa_params), ledger_(ledger) {
         std::cout << "Bank RSA params:" << std::endl;
         rsa_params.print();
+        if (ledger_ != nullptr) {
+            LedgerState state = ledger_->recover();
+            for (uint64_t value: state.balances) {
+                account_values_.create(value);
+            }
+            for (uint64_t note: state.spent_notes) {
+                used_banknotes_.insert(note);
+            }
+            std::cout << "Bank recovered " << state.balances.size() << " accounts and " << state.spent_notes.size()
+                      << " spent banknotes, " << ledger_->recoveredRecords() << " log records replayed" << std::endl;
+        }
     }
 
     uint64_t createBankAccount(uint64_t initial_value) { // создаю клиента банка с фантиками на счету
-        account_values_.push_back(initial_value);
-        return account_values_.size() - 1;
+        uint64_t number;
+        applyChange([&](LedgerRecord &record) {
+            number = account_values_.create(initial_value);
+            record = {LedgerRecord::CREATE, 0, number, initial_value, 0};
+            return true;
+        });
+        return number;
+    }
+
+    // false, and nothing is withdrawn, if the account holds less than BANKNOTE_VALUE
+    bool signBanknote(size_t bank_account_number, uint64_t banknote_number, Banknote &banknote) {
+        return signBanknotes(bank_account_number, &banknote_number, 1, &banknote);
     }
 
-    Banknote signBanknote(size_t bank_account_number, uint64_t banknote_number) {
-        assert(bank_account_number < account_values_.size()); // проверка на то, что счет существует
-        assert(account_values_[bank_account_number] >= BANKNOTE_VALUE);
-        account_values_[bank_account_number] -= BANKNOTE_VALUE;
+    // one withdrawal of count * BANKNOTE_VALUE, the signatures share a batchPow; all or nothing
+    bool signBanknotes(size_t bank_account_number, const uint64_t *banknote_numbers, size_t count,
+                       Banknote *banknotes) {
+        uint64_t total = BANKNOTE_VALUE * count;
+        bool withdrawn = applyChange([&](LedgerRecord &record) {
+            std::atomic<uint64_t> &account_value = account_values_[bank_account_number];
+            uint64_t value = account_value.load(std::memory_order_relaxed);
+            do {
+                if (value < total) {
+                    return false;
+                }
+            } while (!account_value.compare_exchange_weak(value, value - total));
+            record = {LedgerRecord::WITHDRAW, 0, bank_account_number, total, 0};
+            return true;
+        });
+        if (!withdrawn) {
+            if (verbose) {
+                std::cout << "Bank refused to sign " << count << " banknote(s), account "
+                          << bank_account_number << " holds less than " << total << std::endl;
+            }
+            return false;
+        }
 
-        Banknote banknote;
-        banknote.banknote_number = banknote_number;
-        banknote.signature = signMessageRSA(banknote.banknote_number, rsa_params.private_key,
-                                            rsa_params.public_modulus);
-        std::cout << "Bank signed banknote " << banknote_number << " with signature "
-                  << banknote.signature << std::endl;
-        return banknote;
+        std::vector<uint64_t> signatures(count);
+        signMessagesRSA(banknote_numbers, count, private_key_, signatures.data());
+        for (size_t i = 0; i < count; ++i) {
+            banknotes[i].banknote_number = banknote_numbers[i];
+            banknotes[i].signature = signatures[i];
+            if (verbose) {
+                std::cout << "Bank signed banknote " << banknote_numbers[i] << " with signature "
+                          << signatures[i] << std::endl;
+            }
+        }
+        return true;
     }
 
     bool checkBanknoteSignature(const Banknote &banknote) {
-        std::cout << "Bank checks banknote " << banknote.banknote_number << " with signature "
-                  << banknote.signature << std::endl;
+        if (verbose) {
+            std::cout << "Bank checks banknote " << banknote.banknote_number << " with signature "
+                      << banknote.signature << std::endl;
+        }
         if (!checkSignatureRSA(banknote.banknote_number, banknote.signature, rsa_params.public_key,
                                rsa_params.public_modulus)) {
-            std::cout << "Banknote signature is invalid" << std::endl;
+            if (verbose) {
+                std::cout << "Banknote signature is invalid" << std::endl;
+            }
             return false;
         }
 
-        if (isInVector(used_banknotes_, banknote.banknote_number)) {
-            std::cout << "Banknote " << banknote.banknote_number << " is already used" << std::endl;
+        if (!used_banknotes_.insert(banknote.banknote_number)) {
+            if (verbose) {
+                std::cout << "Banknote " << banknote.banknote_number << " is already used" << std::endl;
+            }
             return false;
         }
 
-        used_banknotes_.push_back(banknote.banknote_number);
-
         return true;
     }
 
     bool addBanknoteToAccount(size_t bank_account_number, const Banknote &banknote) {
-        if (!checkBanknoteSignature(banknote)) {
-            return false;
-        }
+        return applyChange([&](LedgerRecord &record) {
+            if (!checkBanknoteSignature(banknote)) {
+                return false;
+            }
 
-        account_values_[bank_account_number] += BANKNOTE_VALUE;
-        return true;
+            account_values_[bank_account_number].fetch_add(BANKNOTE_VALUE);
+            record = {LedgerRecord::DEPOSIT, 0, bank_account_number, BANKNOTE_VALUE, banknote.banknote_number};
+            return true;
+        });
     }
 
     void printAccountValues() {
         std::cout << "Account values:" << std::endl;
         for (size_t i = 0; i < account_values_.size(); ++i) {
-            std::cout << "Account " << i << ": " << account_values_[i] << std::endl;
+            std::cout << "Account " << i << ": " << account_values_[i].load() << std::endl;
         }
     }
 
+    size_t spentBanknoteCount() const {
+        return used_banknotes_.size();
+    }
+
 private:
-    std::vector<uint64_t> account_values_;
-    std::vector<uint64_t> used_banknotes_;
+    RSAPrivateKey private_key_;
+    AccountTable account_values_;
+    ConcurrentSpentNoteIndex used_banknotes_;
+    Ledger *ledger_;
+
+    // change(record) updates memory and fills the record to log, false means nothing changed
+    template<typename Change>
+    bool applyChange(Change change) {
+        LedgerRecord record{};
+        if (ledger_ == nullptr) {
+            return change(record);
+        }
+
+        uint64_t seq;
+        {
+            auto guard = ledger_->guard();
+            if (!change(record)) {
+                return false;
+            }
+            seq = ledger_->append(record);
+        }
+        ledger_->commit(seq); // outside the guard, so commits of many threads share one fdatasync
+        if (ledger_->snapshotDue()) {
+            ledger_->snapshot([this] { return captureState(); });
+        }
+        return true;
+    }
+
+    LedgerState captureState() {
+        LedgerState state;
+        for (size_t i = 0; i < account_values_.size(); ++i) {
+            state.balances.push_back(account_values_[i].load());
+        }
+        used_banknotes_.forEach([&](uint64_t note) { state.spent_notes.push_back(note); });
+        return state;
+    }
 };
 
 class Customer {
 public:
-    Customer(Randomizer &randomizer, Bank &bank) : randomizer_(randomizer),
-                                                   bank_(bank),
-                                                   bank_account_number_(bank.createBankAccount(150)) {}
+    Customer(Randomizer &randomizer, Bank &bank, uint64_t initial_value = 150)
+            : randomizer_(randomizer),
+              bank_(bank),
+              bank_account_number_(bank.createBankAccount(initial_value)) {}
+
+    // false if the bank refused to sign, i.e. the account is short of money
+    bool getBanknoteFromBank(Banknote &banknote) {
+        return getBanknotesFromBank(1, &banknote);
+    }
 
-    Banknote getBanknoteFromBank() {
+    // blinds count fresh banknotes and has the bank sign them in one withdrawal
+    bool getBanknotesFromBank(size_t count, Banknote *banknotes) {
         ModularArithmetic ma(bank_.rsa_params.public_modulus);
-        uint64_t n = randomizer_.random(2, bank_.rsa_params.public_modulus - 1);
-        n = n & (~0b1111); // сделать последние 4 бита нулями, для защиты от фабрикования банкнот
-        std::cout << "Customer generated banknote number = " << n << std::endl;
-        uint64_t r = randomizer_.randomCoprime(1, bank_.rsa_params.public_modulus - 1, bank_.rsa_params.public_modulus);
-        uint64_t n1 = ma.mul(n, ma.pow(r, bank_.rsa_params.public_key)); // n * r^d mod N
-        uint64_t s = bank_.signBanknote(bank_account_number_, n1).signature;
-        uint64_t rr = ma.inv(r);
-        uint64_t s1 = ma.mul(s, rr); // s * r^-1 mod N
-        std::cout << "Customer derived signature = " << s1 << std::endl;
-
-        Banknote banknote;
-        banknote.banknote_number = n;
-        banknote.signature = s1;
-        return banknote;
+        std::vector<uint64_t> numbers(count);
+        std::vector<uint64_t> blinding(count);
+        std::vector<uint64_t> blinded(count);
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t n = randomizer_.random(2, bank_.rsa_params.public_modulus - 1);
+            n = n & (~0b1111); // сделать последние 4 бита нулями, для защиты от фабрикования банкнот
+            if (verbose) {
+                std::cout << "Customer generated banknote number = " << n << std::endl;
+            }
+            uint64_t r = randomizer_.randomCoprime(1, bank_.rsa_params.public_modulus - 1,
+                                                   bank_.rsa_params.public_modulus);
+            numbers[i] = n;
+            blinding[i] = r;
+            blinded[i] = ma.mul(n, ma.pow(r, bank_.rsa_params.public_key)); // n * r^d mod N
+        }
+        std::vector<Banknote> signed_banknotes(count);
+        if (!bank_.signBanknotes(bank_account_number_, blinded.data(), count, signed_banknotes.data())) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t s = signed_banknotes[i].signature;
+            uint64_t rr = ma.inv(blinding[i]);
+            uint64_t s1 = ma.mul(s, rr); // s * r^-1 mod N
+            if (verbose) {
+                std::cout << "Customer derived signature = " << s1 << std::endl;
+            }
+
+            banknotes[i].banknote_number = numbers[i];
+            banknotes[i].signature = s1;
+        }
+        return true;
     }
 
 private:
@@ -128,14 +326,20 @@ public:
                        bank_account_number_(bank.createBankAccount(0)) {}
 
     bool acceptPayment(const Banknote &banknote) {
-        std::cout << "Shop got banknote " << banknote.banknote_number << " with signature "
-                  << banknote.signature << std::endl;
+        if (verbose) {
+            std::cout << "Shop got banknote " << banknote.banknote_number << " with signature "
+                      << banknote.signature << std::endl;
+        }
         if (bank_.addBanknoteToAccount(bank_account_number_, banknote)) {
-            std::cout << "Banknote is valid, payment successful" << std::endl;
+            if (verbose) {
+                std::cout << "Banknote is valid, payment successful" << std::endl;
+            }
             return true;
         }
 
-        std::cout << "Banknote is invalid, payment unsuccessful!" << std::endl;
+        if (verbose) {
+            std::cout << "Banknote is invalid, payment unsuccessful!" << std::endl;
+        }
         return false;
     }
 
@@ -144,15 +348,72 @@ private:
     uint64_t bank_account_number_;
 };
 
+/*
+ * Load generator: every thread owns its own customers and shop, withdraws LOAD_WITHDRAW_BATCH banknotes at a time
+ * and deposits them at the shared bank. It runs with 1, 2, 4, ... up to the requested thread count to show how deposits scale.
+ */
+void runLoad(const Args &args, Bank &bank) {
+    verbose = false;
+    Randomizer load_randomizer(args.seed);
+    for (unsigned threads = 1;; threads = std::min<unsigned>(threads * 2, args.threads)) {
+        std::atomic<uint64_t> accepted{0};
+        auto start_time = std::chrono::high_resolution_clock::now();
+        runThreads(threads, [&](unsigned t) {
+            Randomizer randomizer = load_randomizer.stream(threads * 1000 + t);
+            std::vector<Customer> customers;
+            // round robin in whole batches, so a customer can get up to a batch more than its even share
+            uint64_t share = args.deposits / args.customers + LOAD_WITHDRAW_BATCH;
+            for (uint64_t i = 0; i < args.customers; ++i) {
+                customers.emplace_back(randomizer, bank, BANKNOTE_VALUE * share);
+            }
+            Shop shop(bank);
+            uint64_t thread_accepted = 0;
+            Banknote banknotes[LOAD_WITHDRAW_BATCH];
+            for (uint64_t i = 0, round = 0; i < args.deposits; ++round) {
+                size_t count = (size_t) std::min<uint64_t>(LOAD_WITHDRAW_BATCH, args.deposits - i);
+                i += count;
+                if (!customers[round % customers.size()].getBanknotesFromBank(count, banknotes)) {
+                    continue;
+                }
+                for (size_t j = 0; j < count; ++j) {
+                    thread_accepted += shop.acceptPayment(banknotes[j]);
+                }
+            }
+            accepted += thread_accepted;
+        });
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        double seconds = std::chrono::duration<double>(end_time - start_time).count();
+        std::cout << "threads = " << threads << ": " << accepted << " deposits in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms, "
+                  << (uint64_t) ((double) accepted / seconds) << " deposits/s" << std::endl;
+        if (threads >= args.threads) {
+            break;
+        }
+    }
+    std::cout << "Spent banknotes = " << bank.spentBanknoteCount() << std::endl;
+}
 
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
     Randomizer randomizer(args.seed);
     std::cout << "Randomizer seed = " << args.seed << std::endl;
 
+    std::unique_ptr<Ledger> ledger;
+    if (!args.ledger_dir.empty()) {
+        ledger = std::make_unique<Ledger>(args.ledger_dir, args.snapshot_interval);
+    }
+
+    if (args.load) {
+        Bank bank(randomizer, ledger.get());
+        std::cout << "----- LOAD -----" << std::endl;
+        runLoad(args, bank);
+        return 0;
+    }
+
     std::cout << "----- STEP 0 -----" << std::endl;
 
-    Bank bank(randomizer);
+    Bank bank(randomizer, ledger.get());
     Customer customer = Customer(randomizer, bank);
     Shop shop = Shop(bank);
 
@@ -160,7 +421,11 @@ int main(int argc, char **argv) {
 
     std::cout << "----- STEP 1 -----" << std::endl;
 
-    Banknote banknote = customer.getBanknoteFromBank();
+    Banknote banknote;
+    if (!customer.getBanknoteFromBank(banknote)) {
+        std::cerr << "Withdrawal failed, not enough money on the account" << std::endl;
+        exit(1);
+    }
 
     bank.printAccountValues();
 
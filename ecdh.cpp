@@ -0,0 +1,136 @@
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "EllipticCurve.h"
+#include "InputParser.h"
+#include "Randomizer.h"
+
+const uint64_t DEFAULT_SEED = 123;
+
+struct Args {
+    uint64_t seed;
+    std::string private_key_a;
+    std::string private_key_b;
+    uint64_t handshakes;
+};
+
+Args parseArgs(int argc, char **argv) {
+    Args args = {.seed=DEFAULT_SEED, .private_key_a="", .private_key_b="", .handshakes=0};
+
+    InputParser input(argc, argv);
+    input.parseOption("-s", args.seed);
+    // private keys are decimal or 0x-prefixed hexadecimal, up to 256 bits
+    args.private_key_a = input.getOption("-xa");
+    args.private_key_b = input.getOption("-xb");
+    // benchmark: -n [number of full handshakes with fresh keys]
+    input.parseOption("-n", args.handshakes);
+
+    return args;
+}
+
+// decimal digits, or 0x and hexadecimal digits
+bool isNumber(const std::string &str) {
+    bool hex = str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X');
+    size_t start = hex ? 2 : 0;
+    if (str.size() == start) {
+        return false;
+    }
+    for (size_t i = start; i < str.size(); ++i) {
+        if (!(hex ? std::isxdigit((unsigned char) str[i]) : std::isdigit((unsigned char) str[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the key given on the command line reduced mod n, or a random one
+Uint256 privateKey(const std::string &arg, const EllipticCurve &curve, Randomizer &randomizer) {
+    if (arg.empty()) {
+        return curve.randomScalar(randomizer);
+    }
+    if (!isNumber(arg)) {
+        std::cerr << "Cannot parse private key " << arg << ", use a decimal or 0x-prefixed hexadecimal number"
+                  << std::endl;
+        exit(1);
+    }
+    BigInt key = BigInt::fromString(arg) % toBigInt(curve.order());
+    if (key.isZero()) {
+        std::cerr << "Private key must not be a multiple of the group order" << std::endl;
+        exit(1);
+    }
+    return toUint256(key);
+}
+
+// d * Q, after checking that Q is a curve point (the group order is prime, so no subgroup check is needed)
+Uint256 deriveSharedKey(const EllipticCurve &curve, const Uint256 &private_key, const AffinePoint &public_key) {
+    if (public_key.infinity || !curve.isOnCurve(public_key)) {
+        std::cerr << "Public key is not a point of " << curve.name() << std::endl;
+        exit(1);
+    }
+    AffinePoint shared = curve.mulLadder(private_key, public_key);
+    return shared.x;
+}
+
+void runHandshakes(const Args &args, const EllipticCurve &curve, Randomizer &randomizer) {
+    uint64_t mismatches = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < args.handshakes; ++i) {
+        Uint256 alice_private_key = curve.randomScalar(randomizer);
+        Uint256 bob_private_key = curve.randomScalar(randomizer);
+        AffinePoint alice_public_key = curve.mulGenerator(alice_private_key);
+        AffinePoint bob_public_key = curve.mulGenerator(bob_private_key);
+        mismatches += deriveSharedKey(curve, alice_private_key, bob_public_key) !=
+                      deriveSharedKey(curve, bob_private_key, alice_public_key);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(end_time - start_time).count();
+    std::cout << args.handshakes << " handshakes in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms, "
+              << (uint64_t) ((double) args.handshakes / std::max(seconds, 1e-9)) << " handshakes/s" << std::endl;
+    if (mismatches != 0) {
+        std::cout << mismatches << " handshakes gave different shared keys!" << std::endl;
+    }
+}
+
+/*
+ * Diffie-Hellman over the P-256 curve: Q = d * G is public, both sides get x(d_a * d_b * G).
+ * A uniformly random 256-bit key is about as strong as a 3072-bit modulus in diffie-hellman, but the keys
+ * drawn here all come from the 64-bit seed, so the demo is no stronger than the seed.
+ */
+int main(int argc, char **argv) {
+    Args args = parseArgs(argc, argv);
+    Randomizer randomizer(args.seed);
+    const EllipticCurve &curve = EllipticCurve::p256();
+
+    std::cout << "Randomizer seed = " << args.seed << std::endl;
+    std::cout << "Curve = " << curve.name() << std::endl;
+    std::cout << "Base point (G) = " << curve.generator().toHex() << std::endl;
+
+    std::cout << "----- STEP 1 -----" << std::endl;
+
+    Uint256 alice_private_key = privateKey(args.private_key_a, curve, randomizer);
+    std::cout << "Alice private key (d_a) = " << toHex(alice_private_key) << std::endl;
+    Uint256 bob_private_key = privateKey(args.private_key_b, curve, randomizer);
+    std::cout << "Bob private key (d_b) = " << toHex(bob_private_key) << std::endl;
+
+    std::cout << "----- STEP 2 -----" << std::endl;
+
+    AffinePoint alice_public_key = curve.mulGenerator(alice_private_key);
+    std::cout << "Alice public key (Q_a) = " << alice_public_key.toHex() << std::endl;
+    AffinePoint bob_public_key = curve.mulGenerator(bob_private_key);
+    std::cout << "Bob public key (Q_b) = " << bob_public_key.toHex() << std::endl;
+
+    std::cout << "----- STEP 3 -----" << std::endl;
+
+    Uint256 alice_shared_key = deriveSharedKey(curve, alice_private_key, bob_public_key);
+    std::cout << "Alice shared key (s_ab) = " << toHex(alice_shared_key) << std::endl;
+    Uint256 bob_shared_key = deriveSharedKey(curve, bob_private_key, alice_public_key);
+    std::cout << "Bob shared key (s_ba) = " << toHex(bob_shared_key) << std::endl;
+
+    if (args.handshakes > 0) {
+        std::cout << "----- BENCHMARK -----" << std::endl;
+        runHandshakes(args, curve, randomizer);
+    }
+}
@@ -0,0 +1,227 @@
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "EllipticCurve.h"
+#include "InputParser.h"
+#include "MerkleTree.h"
+#include "Parallel.h"
+#include "Randomizer.h"
+#include "Sha256.h"
+
+const int DEFAULT_SEED = 321;
+
+struct Args {
+    uint64_t seed;
+    std::string message;
+    std::string file;
+    uint64_t threads;
+    uint64_t chunk_size;
+    uint64_t chunk;
+};
+
+Args parseArgs(int argc, char **argv) {
+    Args args = {.seed=DEFAULT_SEED, .message="", .file="", .threads=defaultThreadCount(),
+            .chunk_size=MerkleTree::DEFAULT_CHUNK_SIZE, .chunk=0};
+
+    InputParser input(argc, argv);
+
+    input.parseOption("-s", args.seed);
+    args.message = input.getOption("-m");
+    // file mode: -f [file] [-t threads] [-c chunk size] [-k chunk to verify on its own]
+    args.file = input.getOption("-f");
+    input.parseOption("-t", args.threads);
+    input.parseOption("-c", args.chunk_size);
+    input.parseOption("-k", args.chunk);
+    if (args.chunk_size == 0) {
+        std::cerr << "Chunk size must be positive" << std::endl;
+        exit(1);
+    }
+
+    return args;
+}
+
+struct EcdsaKey {
+    Uint256 private_key;
+    AffinePoint public_key;
+
+    static EcdsaKey generate(const EllipticCurve &curve, Randomizer &randomizer) {
+        EcdsaKey key;
+        key.private_key = curve.randomScalar(randomizer);
+        key.public_key = curve.mulGenerator(key.private_key);
+        return key;
+    }
+
+    void print() {
+        std::cout << "private key = " << toHex(private_key) << std::endl;
+        std::cout << "public key = " << public_key.toHex() << std::endl;
+    }
+};
+
+// the whole SHA-256 digest as a big-endian number mod n, n has 256 bits so nothing is truncated
+Uint256 digestToScalar(const Sha256Digest &digest, const EllipticCurve &curve) {
+    return curve.scalars().reduce(toUint256(BigInt::fromBytes(digest.data(), digest.size())));
+}
+
+// 32 bytes, most significant first
+std::array<uint8_t, 32> toBytes(const Uint256 &x) {
+    std::array<uint8_t, 32> res;
+    for (size_t i = 0; i < res.size(); ++i) {
+        res[31 - i] = (uint8_t) (x[i / 8] >> (8 * (i % 8)));
+    }
+    return res;
+}
+
+/*
+ * Deterministic nonces of RFC 6979 with HMAC-SHA-256: k is derived from the private key and the digest,
+ * so signing needs no randomness at all, the same message always gets the same signature and
+ * two different messages get unrelated nonces. A reused k would give the private key away.
+ */
+class NonceGenerator {
+public:
+    NonceGenerator(const EllipticCurve &curve, const Uint256 &private_key, const Uint256 &z)
+            : order_(curve.order()) {
+        v_.fill(0x01);
+        k_.fill(0x00);
+        std::array<uint8_t, 32> x_bytes = toBytes(private_key);
+        std::array<uint8_t, 32> z_bytes = toBytes(z); // z < n already, so this is bits2octets(h1)
+        for (uint8_t separator: {0x00, 0x01}) {
+            HmacSha256 mac(k_.data(), k_.size());
+            mac.update(v_.data(), v_.size());
+            mac.update(&separator, 1);
+            mac.update(x_bytes.data(), x_bytes.size());
+            mac.update(z_bytes.data(), z_bytes.size());
+            k_ = mac.finalize();
+            v_ = hmac(v_.data(), v_.size());
+        }
+    }
+
+    // the next candidate in [1, n - 1], asked again only when the previous one gave r = 0 or s = 0
+    Uint256 next() {
+        while (true) {
+            if (used_) {
+                uint8_t data[33];
+                std::copy(v_.begin(), v_.end(), data);
+                data[32] = 0x00;
+                k_ = hmac(data, sizeof(data));
+                v_ = hmac(v_.data(), v_.size());
+            }
+            used_ = true;
+            v_ = hmac(v_.data(), v_.size());
+            Uint256 k = toUint256(BigInt::fromBytes(v_.data(), v_.size()));
+            if (!isZero(k) && lessThan(k, order_)) {
+                return k;
+            }
+        }
+    }
+
+private:
+    Uint256 order_;
+    Sha256Digest v_;
+    Sha256Digest k_;
+    bool used_ = false;
+
+    Sha256Digest hmac(const uint8_t *data, size_t size) const {
+        HmacSha256 mac(k_.data(), k_.size());
+        mac.update(data, size);
+        return mac.finalize();
+    }
+};
+
+// (r, s) for the digest scalar z
+void signHash(const Uint256 &z, const EllipticCurve &curve, const EcdsaKey &key, Uint256 &r, Uint256 &s) {
+    const Field256 &sf = curve.scalars();
+    NonceGenerator nonces(curve, key.private_key, z);
+    do {
+        Uint256 k = nonces.next();
+        r = sf.reduce(curve.mulGenerator(k).x); // r = x(k * G) mod n
+        Uint256 u = sf.add(sf.toMontgomery(z), sf.mul(sf.toMontgomery(r), sf.toMontgomery(key.private_key)));
+        s = sf.fromMontgomery(sf.mul(sf.inv(sf.toMontgomery(k)), u)); // s = k^-1 * (z + r * d) mod n
+    } while (isZero(r) || isZero(s));
+}
+
+bool isHashSignatureValid(const Uint256 &z, const Uint256 &r, const Uint256 &s, const EllipticCurve &curve,
+                          const AffinePoint &public_key) {
+    const Field256 &sf = curve.scalars();
+    if (isZero(r) || isZero(s) || !lessThan(r, curve.order()) || !lessThan(s, curve.order()) ||
+        public_key.infinity || !curve.isOnCurve(public_key)) {
+        return false;
+    }
+    Uint256 w = sf.inv(sf.toMontgomery(s));
+    Uint256 u1 = sf.fromMontgomery(sf.mul(sf.toMontgomery(z), w)); // u1 = z * s^-1 mod n
+    Uint256 u2 = sf.fromMontgomery(sf.mul(sf.toMontgomery(r), w)); // u2 = r * s^-1 mod n
+    AffinePoint point = curve.mulAdd(u1, u2, public_key); // u1 * G + u2 * Q
+
+    return !point.infinity && sf.reduce(point.x) == r;
+}
+
+// file mode, see MerkleFile: the whole file digest is signed
+void signFile(const Args &args, const EllipticCurve &curve, const EcdsaKey &key) {
+    MerkleFile file(args.file, args.chunk_size, args.threads);
+    file.printStats();
+    Sha256Digest file_digest = file.signedDigest();
+    std::cout << "Digest(file) = " << toHex(file_digest) << std::endl;
+    Uint256 r, s;
+    signHash(digestToScalar(file_digest, curve), curve, key, r, s);
+    std::cout << "r = " << toHex(r) << std::endl;
+    std::cout << "s = " << toHex(s) << std::endl;
+
+    std::cout << "----- STEP 2 - Verify signature -----" << std::endl;
+
+    Sha256Digest chunk_digest = file.chunkDigest(args.chunk);
+    if (isHashSignatureValid(digestToScalar(chunk_digest, curve), r, s, curve, key.public_key)) {
+        std::cout << "Signature is valid\n";
+    } else {
+        std::cout << "Signature is invalid!\n";
+    }
+}
+
+/*
+ * ECDSA over P-256:
+ * 1. Signer derives k from d and z = SHA-256(message) (RFC 6979), r = x(k * G) mod n, s = k^-1 * (z + r * d) mod n
+ * 2. Verifier computes u1 = z / s, u2 = r / s and accepts if x(u1 * G + u2 * Q) = r (mod n)
+ */
+int main(int argc, char **argv) {
+    Args args = parseArgs(argc, argv);
+    Randomizer randomizer(args.seed);
+    const EllipticCurve &curve = EllipticCurve::p256();
+    std::cout << "Randomizer seed = " << args.seed << std::endl;
+
+    std::cout << "----- STEP 0 -----" << std::endl;
+
+    std::cout << "Curve = " << curve.name() << std::endl;
+    std::cout << "Base point (G) = " << curve.generator().toHex() << std::endl;
+    std::cout << "Order (n) = " << toHex(curve.order()) << std::endl;
+
+    std::cout << "----- STEP 1 - Sign and send message -----" << std::endl;
+
+    EcdsaKey key = EcdsaKey::generate(curve, randomizer);
+    std::cout << "ECDSA key:\n";
+    key.print();
+
+    if (!args.file.empty()) {
+        signFile(args, curve, key);
+        return 0;
+    }
+
+    Sha256Digest digest = Sha256::digest(args.message.data(), args.message.size());
+    Uint256 r, s;
+    signHash(digestToScalar(digest, curve), curve, key, r, s);
+
+    std::cout << "Signed message:\n";
+    std::cout << "message = " << args.message << std::endl;
+    std::cout << "SHA-256(message) = " << toHex(digest) << std::endl;
+    std::cout << "r = " << toHex(r) << std::endl;
+    std::cout << "s = " << toHex(s) << std::endl;
+
+    std::cout << "----- STEP 2 - Verify signature -----" << std::endl;
+
+    Sha256Digest received_digest = Sha256::digest(args.message.data(), args.message.size());
+    std::cout << "Received message SHA-256 = " << toHex(received_digest) << "\n";
+
+    if (isHashSignatureValid(digestToScalar(received_digest, curve), r, s, curve, key.public_key)) {
+        std::cout << "Signature is valid\n";
+    } else {
+        std::cout << "Signature is invalid!\n";
+    }
+}
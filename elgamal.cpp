@@ -1,12 +1,30 @@
+#include <array>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <iostream>
+#include <random>
+#include <vector>
+#include "ChaCha20.h"
 #include "InputParser.h"
+#include "OneTimePad.h"
 #include "Randomizer.h"
 #include "ModularArithmetic.h"
+#include "SafePrime.h"
+#include "Sha256.h"
+#include "functions.h"
 
 const uint64_t DEFAULT_SEED = 123;
 const uint64_t DEFAULT_PUBLIC_BASE = 2;
 const uint64_t DEFAULT_PUBLIC_MODULUS = 30803;
+const size_t HYBRID_CHUNK_SIZE = 1 << 16; // a whole number of ChaCha20 blocks
+const char HYBRID_MAGIC[4] = {'E', 'G', 'H', '2'};
+const size_t HYBRID_TAG_SIZE = sizeof(Sha256Digest);
+const size_t HYBRID_SALT_SIZE = 16;
+const size_t HYBRID_HEADER_SIZE = sizeof(HYBRID_MAGIC) + 2 * 8 + HYBRID_SALT_SIZE;
+// the session keys are only as strong as the shared value mod p, a smaller one is brute-forced through a tag
+const uint64_t HYBRID_MIN_MODULUS = (uint64_t) 1 << 62;
+const uint64_t Q_MAX = UINT64_MAX / 2 - 2;
 
 struct Args {
     uint64_t seed;
@@ -15,6 +33,9 @@ struct Args {
     uint64_t private_key_b;
     uint64_t session_private_key;
     uint64_t message;
+    std::string input_file;
+    std::string output_file;
+    bool decrypt;
 };
 
 Args parseArgs(int argc, char **argv) {
@@ -25,6 +46,9 @@ Args parseArgs(int argc, char **argv) {
             .private_key_b = 0,
             .session_private_key = 0,
             .message = 0,
+            .input_file = "",
+            .output_file = "",
+            .decrypt = false,
     };
 
     InputParser input(argc, argv);
@@ -35,6 +59,15 @@ Args parseArgs(int argc, char **argv) {
     input.parseOption("-k", args.session_private_key);
     input.parseOption("-m", args.message);
 
+    // hybrid mode: -i [file or -] [-o file or -] [-d]; decryption needs the same seed or -cb,
+    // without -p the group is a random 64-bit safe prime with a generator, both drawn from the seed
+    args.input_file = input.getOption("-i");
+    args.output_file = input.getOption("-o");
+    args.decrypt = input.isOptionExists("-d");
+    if (!args.input_file.empty() && !input.isOptionExists("-p")) {
+        args.public_modulus = 0;
+    }
+
     return args;
 }
 
@@ -63,9 +96,234 @@ uint64_t decryptMessage(
     return ma.mul(encrypted_message, ma.pow(session_public_key, -private_key + public_modulus - 1));
 }
 
+struct SessionKeys {
+    std::array<uint32_t, 8> cipher_key;
+    Sha256Digest mac_key;
+};
+
+using SessionSalt = std::array<uint8_t, HYBRID_SALT_SIZE>;
+
+// SHA-256(label || shared value || session public key || salt) with label 1 for the cipher and 2 for the MAC key
+SessionKeys deriveSessionKeys(uint64_t shared_value, uint64_t session_public_key, const SessionSalt &salt) {
+    uint8_t material[1 + 2 * 8 + HYBRID_SALT_SIZE];
+    for (int i = 0; i < 8; ++i) {
+        material[1 + i] = (uint8_t) (shared_value >> (56 - 8 * i));
+        material[9 + i] = (uint8_t) (session_public_key >> (56 - 8 * i));
+    }
+    std::copy(salt.begin(), salt.end(), material + 17);
+    SessionKeys keys;
+    material[0] = 1;
+    Sha256Digest cipher_digest = Sha256::digest(material, sizeof(material));
+    for (size_t i = 0; i < keys.cipher_key.size(); ++i) {
+        keys.cipher_key[i] = (uint32_t) cipher_digest[4 * i] | (uint32_t) cipher_digest[4 * i + 1] << 8 |
+                             (uint32_t) cipher_digest[4 * i + 2] << 16 | (uint32_t) cipher_digest[4 * i + 3] << 24;
+    }
+    material[0] = 2;
+    keys.mac_key = Sha256::digest(material, sizeof(material));
+    return keys;
+}
+
+/*
+ * Symmetric layer of the hybrid mode: ChaCha20 under the session key, then HMAC-SHA-256 over each ciphertext
+ * chunk with its index and a last-chunk flag, so chunks cannot be reordered, dropped or cut off at the end.
+ * Every chunk except the last one is exactly HYBRID_CHUNK_SIZE bytes, the last one is shorter, maybe empty.
+ */
+class HybridCipher {
+public:
+    explicit HybridCipher(const SessionKeys &keys)
+            : chacha_(keys.cipher_key, 0), mac_(keys.mac_key.data(), keys.mac_key.size()),
+              keystream_(HYBRID_CHUNK_SIZE / sizeof(uint32_t)) {}
+
+    // XOR with the next size bytes of the keystream, the same call encrypts and decrypts
+    void crypt(unsigned char *data, size_t size) {
+        size_t blocks = (size + 4 * ChaCha20::BLOCK_WORDS - 1) / (4 * ChaCha20::BLOCK_WORDS);
+        chacha_.generate(keystream_.data(), blocks);
+        padXor(data, (const unsigned char *) keystream_.data(), data, size);
+    }
+
+    Sha256Digest tag(const unsigned char *ciphertext, size_t size, bool last) {
+        uint8_t trailer[9];
+        for (int i = 0; i < 8; ++i) {
+            trailer[i] = (uint8_t) (chunk_index_ >> (56 - 8 * i));
+        }
+        trailer[8] = last ? 1 : 0;
+        ++chunk_index_;
+        mac_.update(ciphertext, size);
+        mac_.update(trailer, sizeof(trailer));
+        return mac_.finalize();
+    }
+
+private:
+    ChaCha20 chacha_;
+    HmacSha256 mac_;
+    std::vector<uint32_t> keystream_;
+    uint64_t chunk_index_ = 0;
+};
+
+// compares every byte, so the time taken does not tell how much of a forged tag was right
+bool tagsEqual(const Sha256Digest &a, const Sha256Digest &b) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+void writeAll(const void *data, size_t size, FILE *output) {
+    if (fwrite(data, 1, size, output) != size) {
+        std::cerr << "Write failed" << std::endl;
+        exit(1);
+    }
+}
+
+// fresh for every message and independent of -s, so two messages never share a keystream
+uint64_t systemRandom(std::random_device &device, uint64_t min, uint64_t max) {
+    std::uniform_int_distribution<uint64_t> distribution(min, max);
+    return distribution(device);
+}
+
+void putUint64(uint64_t value, uint8_t *bytes) {
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = (uint8_t) (value >> (56 - 8 * i));
+    }
+}
+
+uint64_t getUint64(const uint8_t *bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+/*
+ * Hybrid mode: ElGamal carries a fresh session key, the payload goes through HybridCipher.
+ * Output: "EGH2", p, the session public key g^k (both 64-bit big-endian) and a 16-byte salt, then the chunks
+ * each followed by its tag. k and the salt come from the system, not from the seed, the salt alone keeps
+ * the keystreams apart even if k repeats. Decryption checks a chunk's tag before writing its plaintext.
+ * Stats go to stderr, stdout may carry the output.
+ */
+void streamFile(const Args &args, Randomizer &randomizer) {
+    uint64_t public_modulus = args.public_modulus;
+    uint64_t public_base = args.public_base;
+    if (public_modulus == 0) {
+        uint64_t prime_factor = SafePrimeSearch().randomPrimeFactor(randomizer, HYBRID_MIN_MODULUS / 2, Q_MAX);
+        public_modulus = 2 * prime_factor + 1;
+        ModularArithmetic ma(public_modulus);
+        do {
+            public_base = randomizer.random(2, public_modulus - 2);
+        } while (ma.pow(public_base, prime_factor) == 1); // order 2q, g generates the whole group
+    } else if (public_modulus < HYBRID_MIN_MODULUS) {
+        std::cerr << "Public modulus must be at least 2^62 in hybrid mode, omit -p for a random safe prime"
+                  << std::endl;
+        exit(1);
+    }
+
+    FILE *input = openStream(args.input_file, "rb", stdin);
+    FILE *output = openStream(args.output_file, "wb", stdout);
+
+    uint64_t bob_private_key = args.private_key_b;
+    if (bob_private_key == 0) {
+        bob_private_key = randomizer.random(2, public_modulus - 2);
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    uint64_t session_public_key;
+    uint64_t shared_value;
+    SessionSalt salt;
+    ModularArithmetic ma(public_modulus);
+    uint8_t header[HYBRID_HEADER_SIZE];
+    uint8_t *fields = header + sizeof(HYBRID_MAGIC);
+    if (args.decrypt) {
+        if (fread(header, 1, sizeof(header), input) != sizeof(header) ||
+            !std::equal(HYBRID_MAGIC, HYBRID_MAGIC + sizeof(HYBRID_MAGIC), header)) {
+            std::cerr << "Input is not a hybrid ElGamal message" << std::endl;
+            exit(1);
+        }
+        if (getUint64(fields) != public_modulus) {
+            std::cerr << "Message was encrypted with p = " << getUint64(fields) << ", not " << public_modulus
+                      << ", use the same -p or -s" << std::endl;
+            exit(1);
+        }
+        session_public_key = getUint64(fields + 8);
+        std::copy(fields + 16, fields + 16 + HYBRID_SALT_SIZE, salt.begin());
+        shared_value = ma.pow(session_public_key, bob_private_key); // (g^k)^c_b
+    } else {
+        std::random_device device;
+        uint64_t session_private_key = args.session_private_key;
+        if (session_private_key == 0) {
+            session_private_key = systemRandom(device, 2, public_modulus - 2);
+        }
+        for (uint8_t &byte : salt) {
+            byte = (uint8_t) systemRandom(device, 0, UINT8_MAX);
+        }
+        uint64_t bob_public_key = derivePublicKey(bob_private_key, public_base, public_modulus);
+        session_public_key = derivePublicKey(session_private_key, public_base, public_modulus);
+        shared_value = ma.pow(bob_public_key, session_private_key); // (g^c_b)^k
+
+        std::copy(HYBRID_MAGIC, HYBRID_MAGIC + sizeof(HYBRID_MAGIC), header);
+        putUint64(public_modulus, fields);
+        putUint64(session_public_key, fields + 8);
+        std::copy(salt.begin(), salt.end(), fields + 16);
+        writeAll(header, sizeof(header), output);
+    }
+    HybridCipher cipher(deriveSessionKeys(shared_value, session_public_key, salt));
+    auto key_time = std::chrono::high_resolution_clock::now();
+
+    // decryption reads a chunk with its tag, a short read is the last chunk
+    size_t read_size = HYBRID_CHUNK_SIZE + (args.decrypt ? HYBRID_TAG_SIZE : 0);
+    std::vector<unsigned char> buffer(read_size);
+    uint64_t total = 0;
+    for (bool last = false; !last;) {
+        size_t size = fread(buffer.data(), 1, read_size, input);
+        if (ferror(input)) {
+            std::cerr << "Read failed" << std::endl;
+            exit(1);
+        }
+        last = size < read_size;
+        if (args.decrypt) {
+            if (size < HYBRID_TAG_SIZE) {
+                std::cerr << "Message is truncated" << std::endl;
+                exit(1);
+            }
+            size -= HYBRID_TAG_SIZE;
+            Sha256Digest expected;
+            std::copy(buffer.begin() + size, buffer.begin() + size + HYBRID_TAG_SIZE, expected.begin());
+            if (!tagsEqual(cipher.tag(buffer.data(), size, last), expected)) {
+                std::cerr << "Authentication failed, the message was modified" << std::endl;
+                exit(1);
+            }
+            cipher.crypt(buffer.data(), size);
+            writeAll(buffer.data(), size, output);
+        } else {
+            cipher.crypt(buffer.data(), size);
+            Sha256Digest tag = cipher.tag(buffer.data(), size, last);
+            writeAll(buffer.data(), size, output);
+            writeAll(tag.data(), tag.size(), output);
+        }
+        total += size;
+    }
+    closeStream(input, stdin);
+    closeStream(output, stdout);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(end_time - key_time).count();
+    std::cerr << "Public modulus (p) = " << public_modulus << ", base (g) = " << public_base << std::endl;
+    std::cerr << "Session public key (g^k) = " << session_public_key << ", key exchange in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(key_time - start_time).count() << " us"
+              << std::endl;
+    std::cerr << (args.decrypt ? "Decrypted " : "Encrypted ") << total << " bytes in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - key_time).count() << " ms, "
+              << (double) total / 1e6 / std::max(seconds, 1e-9) << " MB/s" << std::endl;
+}
+
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
     Randomizer randomizer(args.seed);
+    if (!args.input_file.empty()) {
+        streamFile(args, randomizer);
+        return 0;
+    }
     if (args.message >= args.public_modulus || args.message == 0) {
         args.message = randomizer.random(1, args.public_modulus - 1);
     }
@@ -1,7 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
 #include <vector>
+#include "Exponentiation.h"
+#include "ModularArithmetic.h"
+#include "Montgomery.h"
+#include "Sha256.h"
 
 uint64_t gcd(uint64_t a, uint64_t b) {
     while (b > 0) {
@@ -11,31 +22,261 @@ uint64_t gcd(uint64_t a, uint64_t b) {
     return a;
 }
 
-// Euler totient function
-uint64_t phi(uint64_t n) {
-    uint64_t count = 1;
-    for (uint64_t i = 2; i < n; ++i) {
-        if (gcd(i, n) == 1) {
-            count++;
+const uint64_t SMALL_PRIMES[] = {
+        2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97,
+        101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199,
+};
+
+// 1 if n is one of SMALL_PRIMES, 0 if it has a factor among them, -1 if undecided
+template<typename T>
+int trialDivision(const T &n) {
+    for (uint64_t p: SMALL_PRIMES) {
+        if (n == T(p)) {
+            return 1;
+        }
+        if (n % T(p) == T(0)) {
+            return 0;
+        }
+    }
+    return n < T(2) ? 0 : -1;
+}
+
+/*
+ * One Miller-Rabin round for odd n > 2, where n - 1 = d * 2^s with d odd.
+ * Returns false if the witness proves n composite.
+ */
+template<typename T>
+bool millerRabinRound(const MontgomeryContext<T> &mont, const T &d, size_t s, const T &witness) {
+    const T &n = mont.modulus();
+    T minus_one = mont.toMontgomery(n - T(1));
+    T x = slidingWindowPow(mont, mont.toMontgomery(witness), d);
+    if (x == mont.one() || x == minus_one) {
+        return true;
+    }
+    for (size_t r = 1; r < s; ++r) {
+        x = mont.sqr(x);
+        if (x == minus_one) {
+            return true;
+        }
+        if (x == mont.one()) {
+            return false;
         }
     }
-    return count;
+    return false;
 }
 
+// Deterministic for every 64-bit n: these seven witnesses have no strong pseudoprime below 2^64
 bool isPrime(uint64_t n) {
-    if (n == 2 || n == 3) return true;
+    int small = trialDivision(n);
+    if (small >= 0) {
+        return small == 1;
+    }
+
+    uint64_t d = n - 1;
+    size_t s = __builtin_ctzll(d);
+    d >>= s;
+
+    MontgomeryContext<uint64_t> mont(n);
+    for (uint64_t witness: {2ULL, 325ULL, 9375ULL, 28178ULL, 450775ULL, 9780504ULL, 1795265022ULL}) {
+        witness %= n;
+        if (witness != 0 && !millerRabinRound(mont, d, s, witness)) {
+            return false;
+        }
+    }
+
+    return true;
+}
 
-    if (n <= 1 || n % 2 == 0 || n % 3 == 0) return false;
+// Probabilistic, a composite passes with probability at most 4^-rounds
+bool isPrime(const BigInt &n, size_t rounds = 40) {
+    int small = trialDivision(n);
+    if (small >= 0) {
+        return small == 1;
+    }
+    if (n.limbCount() == 1) {
+        return isPrime(n.toUint64());
+    }
 
-    for (uint64_t i = 5; i * i <= n; i += 6) {
-        if (n % i == 0 || n % (i + 2) == 0) return false;
+    BigInt d = n - BigInt(1);
+    size_t s = 0;
+    while (!d.testBit(s)) {
+        ++s;
+    }
+    d >>= s;
+
+    // witnesses are derived from n itself so the answer is reproducible
+    std::mt19937_64 rng(n.limb(0) ^ n.limb(1));
+    BigInt witness_range = n - BigInt(3);
+    MontgomeryContext<BigInt> mont(n);
+    for (size_t i = 0; i < rounds; ++i) {
+        std::vector<uint64_t> limbs(n.limbCount());
+        for (uint64_t &limb: limbs) {
+            limb = rng();
+        }
+        BigInt witness = BigInt::fromLimbs(std::move(limbs)) % witness_range + BigInt(2); // [2, n - 2]
+        if (!millerRabinRound(mont, d, s, witness)) {
+            return false;
+        }
     }
 
     return true;
 }
 
+// x^2 + c (mod n) in Montgomery form
+uint64_t pollardStep(const MontgomeryContext<uint64_t> &mont, uint64_t x, uint64_t c) {
+    uint64_t res = mont.sqr(x) + c;
+    if (res >= mont.modulus() || res < c) {
+        res -= mont.modulus();
+    }
+    return res;
+}
+
+/*
+ * Nontrivial factor of an odd composite n with Pollard rho in Brent's variant.
+ * |x - y| is multiplied up over POLLARD_BATCH steps so that a gcd is only taken once per batch,
+ * if the batch overshoots to gcd == n its steps are replayed one gcd at a time.
+ */
+const uint64_t POLLARD_BATCH = 128;
+
+uint64_t pollardBrent(uint64_t n) {
+    MontgomeryContext<uint64_t> mont(n);
+    for (uint64_t c = 1;; ++c) {
+        uint64_t c_mont = mont.toMontgomery(c);
+        uint64_t x, saved_y;
+        uint64_t y = mont.toMontgomery(2);
+        uint64_t product = mont.one();
+        uint64_t divisor = 1;
+        for (uint64_t r = 1; divisor == 1; r *= 2) {
+            x = y;
+            for (uint64_t i = 0; i < r; ++i) {
+                y = pollardStep(mont, y, c_mont);
+            }
+            for (uint64_t k = 0; k < r && divisor == 1; k += POLLARD_BATCH) {
+                saved_y = y;
+                for (uint64_t i = 0; i < std::min(POLLARD_BATCH, r - k); ++i) {
+                    y = pollardStep(mont, y, c_mont);
+                    product = mont.mul(product, x > y ? x - y : y - x);
+                }
+                divisor = gcd(product, n);
+            }
+        }
+
+        if (divisor == n) {
+            do {
+                saved_y = pollardStep(mont, saved_y, c_mont);
+                divisor = gcd(x > saved_y ? x - saved_y : saved_y - x, n);
+            } while (divisor == 1);
+        }
+        if (divisor != n) { // otherwise the cycle closed without splitting n, retry with another constant
+            return divisor;
+        }
+    }
+}
+
+void collectPrimeFactors(uint64_t n, std::vector<uint64_t> &primes) {
+    if (n == 1) {
+        return;
+    }
+    if (isPrime(n)) {
+        primes.push_back(n);
+        return;
+    }
+    uint64_t divisor = pollardBrent(n);
+    collectPrimeFactors(divisor, primes);
+    collectPrimeFactors(n / divisor, primes);
+}
+
+// Factorization as (prime, exponent) pairs in increasing order: SMALL_PRIMES first, then Pollard-Brent
+std::vector<std::pair<uint64_t, unsigned>> factorize(uint64_t n) {
+    std::vector<std::pair<uint64_t, unsigned>> factors;
+    if (n == 0) {
+        return factors;
+    }
+    for (uint64_t p: SMALL_PRIMES) {
+        unsigned exponent = 0;
+        while (n % p == 0) {
+            n /= p;
+            ++exponent;
+        }
+        if (exponent != 0) {
+            factors.emplace_back(p, exponent);
+        }
+    }
+
+    std::vector<uint64_t> primes;
+    collectPrimeFactors(n, primes);
+    std::sort(primes.begin(), primes.end());
+    for (uint64_t p: primes) {
+        if (!factors.empty() && factors.back().first == p) {
+            ++factors.back().second;
+        } else {
+            factors.emplace_back(p, 1);
+        }
+    }
+    return factors;
+}
+
+// Euler totient function
+uint64_t phi(uint64_t n) {
+    uint64_t res = n;
+    for (auto [p, e]: factorize(n)) {
+        res = res / p * (p - 1);
+    }
+    return res;
+}
+
+// order of g in the multiplicative group modulo p, with order_multiple any multiple of it (p - 1 for prime p)
+uint64_t multiplicativeOrder(uint64_t g, uint64_t p, uint64_t order_multiple) {
+    ModularArithmetic ma(p);
+    uint64_t order = order_multiple;
+    for (auto [q, e]: factorize(order_multiple)) {
+        for (unsigned k = 0; k < e && ma.pow(g, order / q) == 1; ++k) {
+            order /= q;
+        }
+    }
+    return order;
+}
+
+bool isPrimitiveRoot(uint64_t g, uint64_t p) {
+    ModularArithmetic ma(p);
+    for (auto [q, e]: factorize(p - 1)) {
+        if (ma.pow(g, (p - 1) / q) == 1) {
+            return false;
+        }
+    }
+    return g % p != 0;
+}
+
+// Jacobi symbol (a / n) for odd n, binary algorithm without exponentiation; for a prime n it is the Legendre symbol
+inline int jacobi(uint64_t a, uint64_t n) {
+    a %= n;
+    int res = 1;
+    while (a != 0) {
+        int zeros = __builtin_ctzll(a);
+        a >>= zeros;
+        if ((zeros & 1) && (n % 8 == 3 || n % 8 == 5)) {
+            res = -res;
+        }
+        if (a % 4 == 3 && n % 4 == 3) {
+            res = -res;
+        }
+        std::swap(a, n);
+        a %= n;
+    }
+    return n == 1 ? res : 0;
+}
+
+// cheap bit mixer for integer keys, spreads low-entropy values over all 64 bits
+inline uint64_t mixHash(uint64_t value) {
+    value ^= value >> 31;
+    value *= 0x9E3779B97F4A7C15ULL;
+    return value ^ (value >> 29);
+}
+
+// leading 32 bits of SHA-256, the signature labs sign with 64-bit moduli and need the hash below them
 size_t hash(const std::string &message) {
-    return std::hash<std::string>{}(message) % UINT32_MAX;
+    Sha256Digest digest = Sha256::digest(message.data(), message.size());
+    return loadBigEndian32(digest.data());
 }
 
 bool isInVector(std::vector<uint64_t> &v, uint64_t x) {
@@ -45,4 +286,32 @@ bool isInVector(std::vector<uint64_t> &v, uint64_t x) {
         }
     }
     return false;
-}
\ No newline at end of file
+}
+
+// the file at path, or the standard stream for an empty path or "-"
+inline FILE *openStream(const std::string &path, const char *mode, FILE *standard) {
+    if (path.empty() || path == "-") {
+        return standard;
+    }
+    FILE *file = fopen(path.c_str(), mode);
+    if (file == nullptr) {
+        std::cerr << "Cannot open " << path << std::endl;
+        exit(1);
+    }
+    return file;
+}
+
+// closes a stream from openStream unless it is the standard one, a failed flush is a write error
+inline void closeStream(FILE *file, FILE *standard) {
+    if (file == standard) {
+        if (fflush(file) != 0) {
+            std::cerr << "Write failed" << std::endl;
+            exit(1);
+        }
+        return;
+    }
+    if (fclose(file) != 0) {
+        std::cerr << "Write failed" << std::endl;
+        exit(1);
+    }
+}
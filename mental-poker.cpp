@@ -1,39 +1,56 @@
+#include <chrono>
 #include <iostream>
+#include <string>
 #include <vector>
 #include <tuple>
+#include "BatchExponentiation.h"
 #include "InputParser.h"
+#include "Parallel.h"
 #include "Randomizer.h"
 #include "ModularArithmetic.h"
+#include "functions.h"
 
 const int DEFAULT_SEED = 321;
-
-const uint8_t CARD_A = 0b00;
-const uint8_t CARD_B = 0b01;
-const uint8_t CARD_C = 0b10;
-
-std::string cardToStr(uint64_t card) {
-    switch (card & 0b11) {
-        case CARD_A:
-            return "Card A";
-        case CARD_B:
-            return "Card B";
-        case CARD_C:
-            return "Card C";
-        default:
-            return "ERROR! This should not happen!";
+const uint64_t DEFAULT_PLAYERS = 2;
+const uint64_t DEFAULT_CARDS = 52;
+const uint64_t DEFAULT_HAND_SIZE = 2;
+const size_t MIN_CARDS_PER_THREAD = 256; // below this a thread costs more than it saves
+
+const std::string RANKS = "23456789TJQKA";
+const std::string SUITS = "cdhs";
+
+// the low bits of a card value are its index in the deck, a standard deck is named by rank and suit
+std::string cardToStr(uint64_t index, uint64_t cards) {
+    if (cards == RANKS.size() * SUITS.size() && index < cards) {
+        return std::string(1, RANKS[index % RANKS.size()]) + SUITS[index / RANKS.size()];
     }
+    return "Card " + std::to_string(index + 1);
 }
 
 struct Args {
     uint64_t seed;
+    uint64_t players;
+    uint64_t cards;
+    uint64_t hand_size;
+    uint64_t threads;
 };
 
 Args parseArgs(int argc, char **argv) {
-    Args args = {.seed=DEFAULT_SEED};
+    Args args = {.seed=DEFAULT_SEED, .players=DEFAULT_PLAYERS, .cards=DEFAULT_CARDS, .hand_size=DEFAULT_HAND_SIZE,
+            .threads=defaultThreadCount()};
 
     InputParser input(argc, argv);
     input.parseOption("-s", args.seed);
-
+    input.parseOption("-players", args.players);
+    input.parseOption("-cards", args.cards);
+    input.parseOption("-hand", args.hand_size);
+    input.parseOption("-t", args.threads);
+
+    if (args.players < 2 || args.cards < 2 || args.hand_size == 0 || args.players * args.hand_size > args.cards) {
+        std::cerr << "Need at least 2 players and players * hand size <= cards" << std::endl;
+        exit(1);
+    }
+    args.threads = std::max<uint64_t>(args.threads, 1);
     return args;
 }
 
@@ -44,6 +61,101 @@ std::tuple<uint64_t, uint64_t> generateKeys(uint64_t p, Randomizer &randomizer)
     return std::make_tuple(d, c);
 }
 
+struct Player {
+    uint64_t d; // decryption exponent
+    uint64_t c; // encryption exponent, c * d = 1 (mod P - 1)
+    std::vector<uint64_t> hand;
+};
+
+/*
+ * Mental poker (SRA) for any number of players: every player in turn encrypts each card with x -> x^c (mod P)
+ * and shuffles the deck. Encryption commutes, so after all passes the deck is shuffled by everyone and known
+ * to no one, and dealing is just handing out positions. A dealt card is decrypted by every other player first
+ * and by its owner last. Each pass is one exponent over many cards, so it runs as a batch split between threads.
+ * All card values are quadratic residues: x^c keeps the Legendre symbol of x, which would otherwise leak one
+ * bit about every encrypted card.
+ */
+class PokerTable {
+public:
+    PokerTable(uint64_t p, uint64_t players, Randomizer &randomizer, unsigned threads)
+            : p_(p), ma_(p), threads_(threads) {
+        for (uint64_t i = 0; i < players; ++i) {
+            auto [d, c] = generateKeys(p, randomizer);
+            players_.push_back({d, c, {}});
+        }
+    }
+
+    // cards[i] = random quadratic residue with i in the low bits
+    std::vector<uint64_t> encodeDeck(uint64_t cards, Randomizer &randomizer) const {
+        int index_bits = bitLength(cards - 1);
+        if ((p_ >> index_bits) < 2) {
+            std::cerr << "P = " << p_ << " is too small for " << cards << " cards" << std::endl;
+            exit(1);
+        }
+        std::vector<uint64_t> deck(cards);
+        for (uint64_t i = 0; i < cards; ++i) {
+            do {
+                deck[i] = ((randomizer.random(1, p_ - 1) >> index_bits) << index_bits) | i;
+            } while (deck[i] <= 1 || deck[i] >= p_ || jacobi(deck[i], p_) != 1);
+        }
+        return deck;
+    }
+
+    void encryptAndShuffle(std::vector<uint64_t> &deck, Randomizer &randomizer) const {
+        for (const Player &player: players_) {
+            parallelPow(deck, player.c);
+            randomizer.shuffle(deck);
+        }
+    }
+
+    // player j gets positions j, j + players, ... of the shuffled deck, decrypted by everyone else first
+    void deal(const std::vector<uint64_t> &deck, uint64_t hand_size) {
+        size_t players = players_.size();
+        std::vector<uint64_t> dealt(deck.begin(), deck.begin() + players * hand_size);
+        for (size_t i = 0; i < players; ++i) {
+            std::vector<uint64_t> others;
+            for (size_t k = 0; k < dealt.size(); ++k) {
+                if (k % players != i) {
+                    others.push_back(dealt[k]);
+                }
+            }
+            parallelPow(others, players_[i].d);
+            for (size_t k = 0, next = 0; k < dealt.size(); ++k) {
+                if (k % players != i) {
+                    dealt[k] = others[next++];
+                }
+            }
+        }
+        for (size_t i = 0; i < players; ++i) {
+            players_[i].hand.clear();
+            for (size_t k = i; k < dealt.size(); k += players) {
+                players_[i].hand.push_back(dealt[k]);
+            }
+            parallelPow(players_[i].hand, players_[i].d);
+        }
+    }
+
+    const std::vector<Player> &players() const {
+        return players_;
+    }
+
+private:
+    uint64_t p_;
+    ModularArithmetic ma_;
+    unsigned threads_;
+    std::vector<Player> players_;
+
+    // values[i] = values[i]^exponent (mod P), the cards split evenly between threads
+    void parallelPow(std::vector<uint64_t> &values, uint64_t exponent) const {
+        unsigned threads = (unsigned) std::clamp<size_t>(values.size() / MIN_CARDS_PER_THREAD, 1, threads_);
+        runThreads(threads, [&](unsigned t) {
+            size_t begin = values.size() * t / threads;
+            size_t end = values.size() * (t + 1) / threads;
+            batchPow(ma_, values.data() + begin, end - begin, exponent, values.data() + begin);
+        });
+    }
+};
+
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
     Randomizer randomizer(args.seed);
@@ -54,61 +166,48 @@ int main(int argc, char **argv) {
     uint64_t p = randomizer.randomPrime(2, UINT64_MAX);
     std::cout << "P = " << p << std::endl;
 
-    auto [d_a, c_a] = generateKeys(p, randomizer);
-    std::cout << "d_a = " << d_a << std::endl;
-    std::cout << "c_a = " << c_a << std::endl;
-
-    auto [d_b, c_b] = generateKeys(p, randomizer);
-    std::cout << "d_b = " << d_b << std::endl;
-    std::cout << "c_b = " << c_b << std::endl;
-
-    std::cout << "----- STEP 1 -----" << std::endl;
-
-    std::vector<uint64_t> cards(3);
-    cards[0] = ((randomizer.random(1, p - 1 - 2) >> 2) << 2) | CARD_A;
-    cards[1] = ((randomizer.random(1, p - 1 - 2) >> 2) << 2) | CARD_B;
-    cards[2] = ((randomizer.random(1, p - 1 - 2) >> 2) << 2) | CARD_C;
-
-    for (auto &card: cards) {
-        std::cout << cardToStr(card) << " == " << card << "\n";
+    PokerTable table(p, args.players, randomizer, args.threads);
+    for (size_t i = 0; i < table.players().size(); ++i) {
+        std::cout << "Player " << i + 1 << ": d = " << table.players()[i].d << ", c = " << table.players()[i].c
+                  << std::endl;
     }
 
-    ModularArithmetic ma(p);
-
-    for (auto &card: cards) {
-        card = ma.pow(card, c_a);
-    }
-    randomizer.shuffle(cards);
+    std::cout << "----- STEP 1 -----" << std::endl;
 
-    std::cout << "Alice sends Bob encrypted shuffled cards:\n";
-    for (auto &card: cards) {
-        std::cout << card << "\n";
-    }
+    std::vector<uint64_t> deck = table.encodeDeck(args.cards, randomizer);
+    std::cout << "Deck of " << deck.size() << " cards encoded as quadratic residues mod P" << std::endl;
 
     std::cout << "----- STEP 2 -----" << std::endl;
 
-    uint64_t alice_encrypted_card = randomizer.pick(cards);
-    std::cout << "Bob sends Alice her encrypted card = " << alice_encrypted_card << "\n";
-
-    uint64_t alice_card = ma.pow(alice_encrypted_card, d_a);
-    std::cout << "Alice card is " << alice_card << " == " << cardToStr(alice_card) << "\n";
+    auto start_time = std::chrono::high_resolution_clock::now();
+    table.encryptAndShuffle(deck, randomizer);
+    auto shuffle_time = std::chrono::high_resolution_clock::now();
+    std::cout << "Every player encrypted and shuffled the deck, top card = " << deck[0] << std::endl;
 
     std::cout << "----- STEP 3 -----" << std::endl;
 
-    for (auto &card: cards) {
-        card = ma.pow(card, c_b);
-    }
-
-    std::cout << "Bob sends Alice remaining encrypted cards:\n";
-    for (auto &card: cards) {
-        std::cout << card << "\n";
+    table.deal(deck, args.hand_size);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    int index_bits = bitLength(args.cards - 1);
+    std::vector<bool> seen(args.cards);
+    for (size_t i = 0; i < table.players().size(); ++i) {
+        std::cout << "Player " << i + 1 << " hand:";
+        for (uint64_t card: table.players()[i].hand) {
+            uint64_t index = card & (((uint64_t) 1 << index_bits) - 1);
+            if (index >= args.cards || seen[index]) {
+                std::cerr << "Card " << card << " was not dealt correctly!" << std::endl;
+                exit(1);
+            }
+            seen[index] = true;
+            std::cout << " " << cardToStr(index, args.cards);
+        }
+        std::cout << std::endl;
     }
+    std::cout << "Cards left in the deck = " << args.cards - args.players * args.hand_size << std::endl;
 
-    std::cout << "----- STEP 4 -----" << std::endl;
-
-    uint64_t bob_encrypted_card = ma.pow(randomizer.pick(cards), d_a);
-    std::cout << "Alice sends Bob his encrypted card = " << bob_encrypted_card << "\n";
-
-    uint64_t bob_card = ma.pow(bob_encrypted_card, d_b);
-    std::cout << "Bob card is " << bob_card << " == " << cardToStr(bob_card) << "\n";
-}
\ No newline at end of file
+    std::cout << "Encrypt and shuffle: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(shuffle_time - start_time).count() << " us, deal: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end_time - shuffle_time).count() << " us, threads = "
+              << args.threads << std::endl;
+}
@@ -1,17 +1,26 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
+#include <vector>
 #include "InputParser.h"
+#include "OneTimePad.h"
 #include "Randomizer.h"
-#include "ModularArithmetic.h"
+#include "functions.h"
 
 const int DEFAULT_SEED = 123;
-const unsigned char ALPHABET_START = 32; // first printable ASCII character
+const unsigned char ALPHABET_START = PAD_ALPHABET_START; // first printable ASCII character
 const unsigned char ALPHABET_END = 126; // last printable ASCII character
-constexpr unsigned char ALPHABET_SIZE = ALPHABET_END - ALPHABET_START + 1;
-ModularArithmetic ma(ALPHABET_SIZE);
+const size_t STREAM_BUFFER_SIZE = 1 << 22;
 
 struct Args {
     uint64_t seed;
     std::string message;
+    std::string input_file;
+    std::string output_file;
+    std::string key_file;
+    bool decrypt;
+    bool xor_mode;
 };
 
 Args parseArgs(int argc, char **argv) {
@@ -20,9 +29,26 @@ Args parseArgs(int argc, char **argv) {
 
     input.parseOption("-s", args.seed);
 
+    // streaming mode: -i [file or -] [-o file or -] [-k key file] [-d] [-xor]
+    args.input_file = input.getOption("-i");
+    args.output_file = input.getOption("-o");
+    args.key_file = input.getOption("-k");
+    args.decrypt = input.isOptionExists("-d");
+    args.xor_mode = input.isOptionExists("-xor");
+    if (!args.input_file.empty()) {
+        // the pad and the data must come from different streams
+        std::error_code error;
+        if (args.key_file == "-" || args.key_file == args.input_file ||
+            (!args.key_file.empty() && std::filesystem::equivalent(args.key_file, args.input_file, error))) {
+            std::cerr << "Key file must be a file other than the input" << std::endl;
+            exit(1);
+        }
+        return args;
+    }
+
     args.message = input.getOption("-m");
     if (args.message.empty()) {
-        std::cerr << "Message is required, use -m [message]" << std::endl;
+        std::cerr << "Message is required, use -m [message] or -i [file]" << std::endl;
         exit(1);
     }
     for (char &c: args.message) {
@@ -35,36 +61,117 @@ Args parseArgs(int argc, char **argv) {
     return args;
 }
 
+// next size bytes of the pad: raw bytes for XOR, uniform printable characters otherwise
+void generatePad(Randomizer &randomizer, unsigned char *pad, size_t size, bool printable,
+                 std::vector<unsigned char> &scratch) {
+    if (!printable) {
+        randomizer.fillBytes(pad, size);
+        return;
+    }
+    // bytes below 2 * 95 map to the alphabet evenly, the rest are rejected; kept ones are compacted in place
+    size_t filled = 0;
+    while (filled < size) {
+        scratch.resize(size - filled);
+        randomizer.fillBytes(scratch.data(), scratch.size());
+        size_t kept = 0;
+        for (unsigned char b: scratch) {
+            scratch[kept] = padReduce(b) + ALPHABET_START;
+            kept += b < 2 * PAD_ALPHABET_SIZE;
+        }
+        std::copy(scratch.begin(), scratch.begin() + kept, pad + filled);
+        filled += kept;
+    }
+}
+
 std::string generate_key(size_t length, Randomizer &randomizer) {
     std::cout << "Generating random key of length " << length << std::endl;
     std::cout << "Key alphabet - 95 printable ASCII characters" << std::endl;
-    std::string key;
-    for (size_t i = 0; i < length; ++i) {
-        key += randomizer.random(ALPHABET_START, ALPHABET_END);
-    }
+    std::string key(length, '\0');
+    std::vector<unsigned char> scratch;
+    generatePad(randomizer, (unsigned char *) key.data(), length, true, scratch);
 
     return key;
 }
 
 std::string encrypt(const std::string &message, const std::string &key) {
-    std::string encrypted;
-    for (size_t i = 0; i < message.length(); ++i) {
-        encrypted += ma.add(message[i] - ALPHABET_START, key[i] - ALPHABET_START) + ALPHABET_START;
-    }
+    std::string encrypted(message.length(), '\0');
+    padPrintable((const unsigned char *) message.data(), (const unsigned char *) key.data(),
+                 (unsigned char *) encrypted.data(), message.length(), false);
     return encrypted;
 }
 
 std::string decrypt(const std::string &encrypted, const std::string &key) {
-    std::string message;
-    for (size_t i = 0; i < encrypted.length(); ++i) {
-        message += ma.sub(encrypted[i] - ALPHABET_START, key[i] - ALPHABET_START) + ALPHABET_START;
-    }
+    std::string message(encrypted.length(), '\0');
+    padPrintable((const unsigned char *) encrypted.data(), (const unsigned char *) key.data(),
+                 (unsigned char *) message.data(), encrypted.length(), true);
     return message;
 }
 
+/*
+ * Streaming mode: input is processed in fixed buffers, the pad comes from the key file or is generated
+ * from the seed, so decryption with the same seed or key file restores the input. Stats go to stderr,
+ * stdout may carry the output.
+ */
+void streamFile(const Args &args) {
+    FILE *input = openStream(args.input_file, "rb", stdin);
+    FILE *output = openStream(args.output_file, "wb", stdout);
+    FILE *key_file = args.key_file.empty() ? nullptr : openStream(args.key_file, "rb", nullptr);
+    Randomizer randomizer(args.seed, Randomizer::CHACHA20);
+
+    std::vector<unsigned char> buffer(STREAM_BUFFER_SIZE), pad(STREAM_BUFFER_SIZE), scratch;
+    uint64_t total = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (size_t size; (size = fread(buffer.data(), 1, buffer.size(), input)) > 0;) {
+        if (key_file != nullptr) {
+            if (fread(pad.data(), 1, size, key_file) != size) {
+                if (ferror(key_file)) {
+                    std::cerr << "Read failed" << std::endl;
+                    exit(1);
+                }
+                std::cerr << "Key file is shorter than the input" << std::endl;
+                exit(1);
+            }
+        } else {
+            generatePad(randomizer, pad.data(), size, !args.xor_mode, scratch);
+        }
+
+        if (args.xor_mode) {
+            padXor(buffer.data(), pad.data(), buffer.data(), size);
+        } else {
+            padPrintable(buffer.data(), pad.data(), buffer.data(), size, args.decrypt);
+        }
+
+        if (fwrite(buffer.data(), 1, size, output) != size) {
+            std::cerr << "Write failed" << std::endl;
+            exit(1);
+        }
+        total += size;
+    }
+    if (ferror(input)) {
+        std::cerr << "Read failed" << std::endl;
+        exit(1);
+    }
+    closeStream(input, stdin);
+    closeStream(output, stdout);
+    if (key_file != nullptr) {
+        closeStream(key_file, nullptr);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(end_time - start_time).count();
+    std::cerr << (args.decrypt ? "Decrypted " : "Encrypted ") << total << " bytes ("
+              << (args.xor_mode ? "XOR" : "printable") << ") in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms, "
+              << (double) total / 1e6 / std::max(seconds, 1e-9) << " MB/s" << std::endl;
+}
+
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
-    Randomizer randomizer(args.seed);
+    if (!args.input_file.empty()) {
+        streamFile(args);
+        return 0;
+    }
+    Randomizer randomizer(args.seed, Randomizer::CHACHA20);
 
     std::cout << "Randomizer seed = " << args.seed << std::endl;
     std::cout << "Message: \"" << args.message  << "\" (" << args.message.length() << " characters)" << std::endl;
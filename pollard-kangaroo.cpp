@@ -0,0 +1,81 @@
+#include <iostream>
+#include "InputParser.h"
+#include "ModularArithmetic.h"
+#include "Parallel.h"
+#include "Pollard.h"
+
+const uint64_t DEFAULT_P = 30803;
+const uint64_t DEFAULT_G = 2;
+
+struct Args {
+    uint64_t p;
+    uint64_t g;
+    uint64_t x;
+    uint64_t lo;
+    uint64_t hi;
+    uint64_t threads;
+    uint64_t dp_bits;
+};
+
+Args parseArgs(int argc, char **argv) {
+    Args args = {.p=DEFAULT_P, .g=DEFAULT_G, .x=0, .lo=0, .hi=0, .threads=defaultThreadCount(), .dp_bits=0};
+    InputParser input(argc, argv);
+    input.parseOption("-p", args.p);
+    input.parseOption("-g", args.g);
+    input.parseOption("-x", args.x);
+    args.hi = args.p - 2;
+    input.parseOption("-a", args.lo);
+    input.parseOption("-b", args.hi);
+    input.parseOption("-t", args.threads);
+    args.dp_bits = defaultDistinguishedBits(args.hi - args.lo);
+    input.parseOption("-d", args.dp_bits);
+    if (args.x == 0) {
+        std::cerr << "Exponent is required, use -x [exp]" << std::endl;
+        exit(1);
+    }
+    if (args.x >= args.p) {
+        std::cerr << "Exponent must be less than p" << std::endl;
+        exit(1);
+    }
+    if (args.lo > args.hi) {
+        std::cerr << "Interval is empty, use -a [min] -b [max]" << std::endl;
+        exit(1);
+    }
+    return args;
+}
+
+int main(int argc, char **argv) {
+    Args args = parseArgs(argc, argv);
+    std::cout << "Parameters:\n";
+
+    ModularArithmetic ma(args.p);
+
+    uint64_t p = args.p;
+    uint64_t g = args.g;
+    uint64_t x = args.x;
+
+    uint64_t y = ma.pow(g, x);
+
+    std::cout << "p = " << p << std::endl;
+    std::cout << "g = " << g << std::endl;
+    std::cout << "x = " << x << std::endl;
+    std::cout << "y = " << y << std::endl;
+    std::cout << "x in [" << args.lo << ", " << args.hi << "]" << std::endl;
+
+    std::cout << "----- Cracking -----" << std::endl;
+    std::cout << "threads = " << args.threads << std::endl;
+    std::cout << "distinguished bits = " << args.dp_bits << std::endl;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    PollardKangaroo kangaroo(p, g, args.threads, args.dp_bits);
+    uint64_t exponent;
+    if (kangaroo.solve(y, args.lo, args.hi, exponent)) {
+        auto end_time = std::chrono::high_resolution_clock::now();
+        std::cout << "Cracked in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms!"
+                  << " exponent was " << exponent << std::endl;
+    } else {
+        std::cout << "Exponent not found in the interval" << std::endl;
+    }
+}
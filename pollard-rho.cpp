@@ -0,0 +1,75 @@
+#include <iostream>
+#include "InputParser.h"
+#include "ModularArithmetic.h"
+#include "Parallel.h"
+#include "Pollard.h"
+
+const uint64_t DEFAULT_P = 30803;
+const uint64_t DEFAULT_G = 2;
+const uint64_t DEFAULT_SEED = 123;
+
+struct Args {
+    uint64_t p;
+    uint64_t g;
+    uint64_t x;
+    uint64_t seed;
+    uint64_t threads;
+    uint64_t dp_bits;
+};
+
+Args parseArgs(int argc, char **argv) {
+    Args args = {.p=DEFAULT_P, .g=DEFAULT_G, .x=0, .seed=DEFAULT_SEED, .threads=defaultThreadCount(), .dp_bits=0};
+    InputParser input(argc, argv);
+    input.parseOption("-p", args.p);
+    input.parseOption("-g", args.g);
+    input.parseOption("-x", args.x);
+    input.parseOption("-s", args.seed);
+    input.parseOption("-t", args.threads);
+    args.dp_bits = defaultDistinguishedBits(args.p);
+    input.parseOption("-d", args.dp_bits);
+    if (args.x == 0) {
+        std::cerr << "Exponent is required, use -x [exp]" << std::endl;
+        exit(1);
+    }
+    if (args.x >= args.p) {
+        std::cerr << "Exponent must be less than p" << std::endl;
+        exit(1);
+    }
+    return args;
+}
+
+int main(int argc, char **argv) {
+    Args args = parseArgs(argc, argv);
+    std::cout << "Parameters:\n";
+
+    ModularArithmetic ma(args.p);
+
+    uint64_t p = args.p;
+    uint64_t g = args.g;
+    uint64_t x = args.x;
+
+    uint64_t y = ma.pow(g, x);
+
+    std::cout << "p = " << p << std::endl;
+    std::cout << "g = " << g << std::endl;
+    std::cout << "x = " << x << std::endl;
+    std::cout << "y = " << y << std::endl;
+
+    std::cout << "----- Cracking -----" << std::endl;
+    std::cout << "threads = " << args.threads << std::endl;
+    std::cout << "distinguished bits = " << args.dp_bits << std::endl;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    PollardRho rho(p, g, args.threads, args.dp_bits);
+    uint64_t exponent;
+    if (rho.solve(y, args.seed, exponent)) {
+        auto end_time = std::chrono::high_resolution_clock::now();
+        std::cout << "Cracked in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms!"
+                  << " exponent was " << exponent << std::endl;
+    } else {
+        std::cerr << "Not cracked, y is not a power of g" << std::endl;
+        return 1;
+    }
+}
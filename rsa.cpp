@@ -1,3 +1,4 @@
+#include <chrono>
 #include <iostream>
 #include "InputParser.h"
 #include "functions.h"
@@ -11,10 +12,13 @@ const uint64_t DEFAULT_D_A = 3;
 const uint64_t DEFAULT_P_B = 113;
 const uint64_t DEFAULT_Q_B = 281;
 const uint64_t DEFAULT_D_B = 3;
+const uint64_t MIN_LARGE_KEY_BITS = 64;
+const uint64_t MAX_LARGE_KEY_BITS = 16384;
 
 struct Args {
     uint64_t seed;
     uint64_t message;
+    uint64_t bits;
     RSAParams a;
     RSAParams b;
 };
@@ -22,6 +26,8 @@ struct Args {
 Args parseArgs(int argc, char **argv) {
     Args args = {
             .seed=DEFAULT_SEED,
+            .message=0,
+            .bits=0,
             .a{
                     .p=DEFAULT_P_A,
                     .q=DEFAULT_Q_A,
@@ -44,14 +50,64 @@ Args parseArgs(int argc, char **argv) {
     input.parseOption("-qb", args.b.q);
     input.parseOption("-db", args.b.public_key);
     input.parseOption("-m", args.message);
+    // large key mode: -bits N, Bob gets a fresh N-bit BigInt key and the message is random below it
+    input.parseOption("-bits", args.bits);
+    if (args.bits != 0 && (args.bits < MIN_LARGE_KEY_BITS || args.bits > MAX_LARGE_KEY_BITS)) {
+        std::cerr << "Key size must be from " << MIN_LARGE_KEY_BITS << " to " << MAX_LARGE_KEY_BITS << " bits"
+                  << std::endl;
+        exit(1);
+    }
 
     return args;
 }
 
+/*
+ * Large key mode: the same exchange with BigInt keys, e.g. -bits 2048, timed step by step.
+ * The primes come from the seeded randomizer, so the key is reproducible with -s and only fit for the demo.
+ */
+void runLargeKey(uint64_t bits, Randomizer &randomizer) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    BasicRSAParams<BigInt> b = BasicRSAParams<BigInt>::generate(randomizer, bits);
+    BasicRSAPrivateKey<BigInt> b_private_key(b);
+    auto key_time = std::chrono::high_resolution_clock::now();
+    b.print();
+
+    BigInt message = randomizer.random(BigInt(0), b.public_modulus - BigInt(1));
+    std::cout << "Message (m) = " << message << std::endl;
+
+    std::cout << "----- STEP 1 -----" << std::endl;
+
+    BigInt encrypted_message = encryptMessageRSA(message, b.public_key, b.public_modulus);
+    auto encrypt_time = std::chrono::high_resolution_clock::now();
+    std::cout << "Alice sends Bob encrypted message (e) = " << encrypted_message << std::endl;
+
+    std::cout << "----- STEP 2 -----" << std::endl;
+
+    BigInt decrypted_message = decryptMessageRSA(encrypted_message, b_private_key);
+    auto decrypt_time = std::chrono::high_resolution_clock::now();
+    std::cout << "Bob decrypts message (m') = " << decrypted_message << std::endl;
+    if (decrypted_message != message) {
+        std::cerr << "Decrypted message differs from the original" << std::endl;
+        exit(1);
+    }
+
+    std::cout << bits << "-bit key generated in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(key_time - start_time).count()
+              << " ms, encrypted in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(encrypt_time - key_time).count()
+              << " us, decrypted in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(decrypt_time - encrypt_time).count()
+              << " us" << std::endl;
+}
+
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
     Randomizer randomizer(args.seed);
     std::cout << "Randomizer seed = " << args.seed << std::endl;
+    if (args.bits != 0) {
+        runLargeKey(args.bits, randomizer);
+        return 0;
+    }
 
     RSAParams a = args.a;
     std::cout << "P_a = " << a.p << std::endl;
@@ -99,7 +155,7 @@ int main(int argc, char **argv) {
 
     std::cout << "----- STEP 2 -----" << std::endl;
 
-    uint64_t decrypted_message = decryptMessageRSA(
-            encrypted_message, b.private_key, b.public_modulus);
+    RSAPrivateKey b_private_key(b);
+    uint64_t decrypted_message = decryptMessageRSA(encrypted_message, b_private_key);
     std::cout << "Bob decrypts message (m') = " << decrypted_message << std::endl;
 }
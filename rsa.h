@@ -1,61 +1,96 @@
 #pragma once
 
 #include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "BatchExponentiation.h"
 #include "ModularArithmetic.h"
 
 uint64_t generatePublicKeyRSA(uint64_t private_modulus, Randomizer &randomizer) {
     return randomizer.randomCoprime(2, private_modulus - 1, private_modulus);
 }
 
-uint64_t derivePrivateKeyRSA(uint64_t public_key, uint64_t private_modulus) {
-    ModularArithmetic ma(private_modulus);
+// T is uint64_t or BigInt, see BasicModularArithmetic
+template<typename T>
+T derivePrivateKeyRSA(const T &public_key, const T &private_modulus) {
+    BasicModularArithmetic<T> ma(private_modulus);
     return ma.inv(public_key);
 }
 
-uint64_t encryptMessageRSA(uint64_t message, uint64_t public_key, uint64_t public_modulus) {
-    ModularArithmetic ma(public_modulus);
+template<typename T>
+T encryptMessageRSA(const T &message, const T &public_key, const T &public_modulus) {
+    BasicModularArithmetic<T> ma(public_modulus);
     return ma.pow(message, public_key);
 }
 
-uint64_t decryptMessageRSA(uint64_t encrypted_message, uint64_t private_key, uint64_t public_modulus) {
-    ModularArithmetic ma(public_modulus);
+template<typename T>
+T decryptMessageRSA(const T &encrypted_message, const T &private_key, const T &public_modulus) {
+    BasicModularArithmetic<T> ma(public_modulus);
     return ma.pow(encrypted_message, private_key);
 }
 
-uint64_t signMessageRSA(uint64_t message_hash, uint64_t private_key, uint64_t public_modulus) {
-    ModularArithmetic ma(public_modulus);
+template<typename T>
+T signMessageRSA(const T &message_hash, const T &private_key, const T &public_modulus) {
+    BasicModularArithmetic<T> ma(public_modulus);
     return ma.pow(message_hash, private_key);
 }
 
-uint64_t getMessageHashRSA(uint64_t signature, uint64_t public_key, uint64_t public_modulus) {
-    ModularArithmetic ma(public_modulus);
+template<typename T>
+T getMessageHashRSA(const T &signature, const T &public_key, const T &public_modulus) {
+    BasicModularArithmetic<T> ma(public_modulus);
     return ma.pow(signature, public_key);
 }
 
-uint64_t checkSignatureRSA(uint64_t message_hash, uint64_t signature, uint64_t public_key, uint64_t public_modulus) {
+template<typename T>
+bool checkSignatureRSA(const T &message_hash, const T &signature, const T &public_key, const T &public_modulus) {
     return getMessageHashRSA(signature, public_key, public_modulus) == message_hash;
 }
 
-struct RSAParams {
-    uint64_t p;
-    uint64_t q;
-    uint64_t public_key;
-    uint64_t private_key;
-    uint64_t private_modulus;
-    uint64_t public_modulus;
-
-    static RSAParams generate(Randomizer &randomizer) {
-        RSAParams params;
-        params.p = randomizer.randomPrime(UINT16_MAX, UINT32_MAX);
-        params.q = randomizer.randomPrime(UINT16_MAX, UINT32_MAX);
-        params.public_modulus = params.p * params.q;
-        params.private_modulus = (params.p - 1) * (params.q - 1);
-        params.public_key = generatePublicKeyRSA(params.private_modulus, randomizer);
+template<typename T>
+struct BasicRSAParams {
+    static constexpr uint64_t PUBLIC_EXPONENT = 65537;
+
+    T p;
+    T q;
+    T public_key;
+    T private_key;
+    T private_modulus;
+    T public_modulus;
+
+    // keys of any size from externally generated primes p, q and public exponent e
+    static BasicRSAParams fromPrimes(const T &p, const T &q, const T &public_key) {
+        BasicRSAParams params;
+        params.p = p;
+        params.q = q;
+        params.public_modulus = p * q;
+        params.private_modulus = (p - T(1)) * (q - T(1));
+        params.public_key = public_key;
         params.private_key = derivePrivateKeyRSA(params.public_key, params.private_modulus);
 
         return params;
     }
 
+    // 64-bit demo keys: two primes below 2^32 and a random public exponent
+    static BasicRSAParams generate(Randomizer &randomizer) {
+        static_assert(std::is_same<T, uint64_t>::value, "BigInt keys take a size, use generate(randomizer, bits)");
+        T p = randomizer.randomPrime(UINT16_MAX, UINT32_MAX);
+        T q = randomizer.randomPrime(UINT16_MAX, UINT32_MAX);
+        return fromPrimes(p, q, generatePublicKeyRSA((p - 1) * (q - 1), randomizer));
+    }
+
+    // modulus of exactly bits bits, at most 64 for uint64_t, and public exponent PUBLIC_EXPONENT
+    static BasicRSAParams generate(Randomizer &randomizer, size_t bits) {
+        T public_key(PUBLIC_EXPONENT);
+        while (true) {
+            T p = randomPrime(randomizer, bits / 2);
+            T q = randomPrime(randomizer, bits - bits / 2);
+            // e must be invertible mod (p - 1) * (q - 1)
+            if (p != q && (p - T(1)) % public_key != T(0) && (q - T(1)) % public_key != T(0)) {
+                return fromPrimes(p, q, public_key);
+            }
+        }
+    }
+
     void print() const {
         std::cout << "p = " << p << std::endl;
         std::cout << "q = " << q << std::endl;
@@ -64,4 +99,108 @@ struct RSAParams {
         std::cout << "d = " << public_key << std::endl;
         std::cout << "c = " << private_key << std::endl;
     }
-};
\ No newline at end of file
+
+private:
+    // prime with the top two of its bits bits set, so the product of two has the full size
+    static T randomPrime(Randomizer &randomizer, size_t bits) {
+        if constexpr (std::is_same<T, BigInt>::value) {
+            return randomizer.randomBigPrime(bits);
+        } else {
+            uint64_t top = (uint64_t) 3 << (bits - 2);
+            return randomizer.randomPrime(top, top | (((uint64_t) 1 << (bits - 2)) - 1));
+        }
+    }
+};
+
+using RSAParams = BasicRSAParams<uint64_t>;
+
+/*
+ * RSA private key in CRT form: c^d mod N from two half-size exponentiations joined with Garner's formula.
+ * Shamir's fault check: the halves are computed modulo p*r and q*r for a small prime r,
+ * and a fault in either one shows up as c^d mod r disagreeing between them.
+ * A faulty result is never returned, the key falls back to the full exponentiation mod N instead.
+ */
+template<typename T>
+class BasicRSAPrivateKey {
+public:
+    static constexpr uint64_t FAULT_CHECK_PRIME = 65521;
+
+    explicit BasicRSAPrivateKey(const BasicRSAParams<T> &params)
+            : p_(params.p), q_(params.q), check_(FAULT_CHECK_PRIME),
+              pr_(fitsCheck(params.p) ? params.p * check_ : params.p),
+              qr_(fitsCheck(params.q) ? params.q * check_ : params.q),
+              ma_n_(params.public_modulus), ma_p_(params.p), ma_pr_(pr_), ma_qr_(qr_),
+              private_key_(params.private_key) {
+        if (pr_ == p_ || qr_ == q_) { // p * r does not fit into T
+            check_ = T(1);
+        }
+        // d mod lcm(p - 1, r - 1) would do, (p - 1) * (r - 1) is simpler and still a multiple
+        d_pr_ = private_key_ % ((p_ - T(1)) * (check_ == T(1) ? T(1) : check_ - T(1)));
+        d_qr_ = private_key_ % ((q_ - T(1)) * (check_ == T(1) ? T(1) : check_ - T(1)));
+        q_inv_ = ma_p_.inv(q_ % p_);
+    }
+
+    // c^d mod N
+    T apply(const T &c) const {
+        return combine(c, ma_pr_.pow(c, d_pr_), ma_qr_.pow(c, d_qr_));
+    }
+
+    // res[i] = c[i]^d mod N for i < count with both halves through batchPow, res may be the same array as c
+    void apply(const T *c, size_t count, T *res) const {
+        static_assert(std::is_same<T, uint64_t>::value, "batchPow works on 64-bit values");
+        std::vector<T> s_pr(count), s_qr(count);
+        batchPow(ma_pr_, c, count, d_pr_, s_pr.data());
+        batchPow(ma_qr_, c, count, d_qr_, s_qr.data());
+        for (size_t i = 0; i < count; ++i) {
+            res[i] = combine(c[i], s_pr[i], s_qr[i]);
+        }
+    }
+
+private:
+    T p_;
+    T q_;
+    T check_;
+    T pr_;
+    T qr_;
+    BasicModularArithmetic<T> ma_n_;
+    BasicModularArithmetic<T> ma_p_;
+    BasicModularArithmetic<T> ma_pr_;
+    BasicModularArithmetic<T> ma_qr_;
+    T private_key_;
+    T d_pr_;
+    T d_qr_;
+    T q_inv_;
+
+    // Garner's formula on the halves mod p*r and q*r, or the full exponentiation if they disagree mod r
+    T combine(const T &c, const T &s_pr, const T &s_qr) const {
+        if (s_pr % check_ != s_qr % check_) {
+            return ma_n_.pow(c, private_key_);
+        }
+
+        T s_p = s_pr % p_;
+        T s_q = s_qr % q_;
+        T h = ma_p_.mul(q_inv_, ma_p_.sub(s_p, s_q));
+        return s_q + h * q_;
+    }
+
+    bool fitsCheck(const T &prime) const {
+        return (prime * check_) / check_ == prime;
+    }
+};
+
+using RSAPrivateKey = BasicRSAPrivateKey<uint64_t>;
+
+template<typename T>
+T decryptMessageRSA(const T &encrypted_message, const BasicRSAPrivateKey<T> &key) {
+    return key.apply(encrypted_message);
+}
+
+template<typename T>
+T signMessageRSA(const T &message_hash, const BasicRSAPrivateKey<T> &key) {
+    return key.apply(message_hash);
+}
+
+// signs count hashes at once, res may be the same array as message_hashes
+inline void signMessagesRSA(const uint64_t *message_hashes, size_t count, const RSAPrivateKey &key, uint64_t *res) {
+    key.apply(message_hashes, count, res);
+}
@@ -1,19 +1,36 @@
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <iostream>
 #include <cstdint>
+#include <deque>
+#include <mutex>
 #include <tuple>
 #include <utility> // for std::swap, std::pair
+#include <vector>
+#include "BatchExponentiation.h"
 #include "InputParser.h"
 #include "functions.h"
+#include "Parallel.h"
 #include "Randomizer.h"
 #include "ModularArithmetic.h"
+#include "Sha256.h"
 
 const uint64_t DEFAULT_SEED = 123;
 const uint64_t DEFAULT_PUBLIC_MODULUS = 30803;
+const uint64_t DEFAULT_BLOCK_SIZE = 1 << 20;
+constexpr size_t PASSES = 4;
+constexpr uint64_t ELEMENT_OFFSET = 2; // 0 and 1 are fixed points of every exponent, payload values skip them
 
 struct Args {
     uint64_t seed;
     uint64_t public_modulus;
     uint64_t message;
+    std::string input_file;
+    std::string output_file;
+    uint64_t threads;
+    uint64_t block_size;
 };
 
 Args parseArgs(int argc, char **argv) {
@@ -21,6 +38,10 @@ Args parseArgs(int argc, char **argv) {
             .seed=DEFAULT_SEED,
             .public_modulus=DEFAULT_PUBLIC_MODULUS,
             .message=0,
+            .input_file="",
+            .output_file="",
+            .threads=defaultThreadCount(),
+            .block_size=DEFAULT_BLOCK_SIZE,
     };
 
     InputParser input(argc, argv);
@@ -28,6 +49,18 @@ Args parseArgs(int argc, char **argv) {
     input.parseOption("-p", args.public_modulus);
     input.parseOption("-message", args.message);
 
+    // streaming mode: -i [file or -] [-o file or -] [-t threads] [-block bytes], without -p the modulus
+    // is a random 64-bit prime
+    args.input_file = input.getOption("-i");
+    args.output_file = input.getOption("-o");
+    input.parseOption("-t", args.threads);
+    input.parseOption("-block", args.block_size);
+    if (!args.input_file.empty() && !input.isOptionExists("-p")) {
+        args.public_modulus = 0;
+    }
+    args.threads = std::max<uint64_t>(args.threads, 1);
+    args.block_size = std::max<uint64_t>(args.block_size, 1);
+
     return args;
 }
 
@@ -42,10 +75,220 @@ std::pair<uint64_t, uint64_t> generatePrivateKeyPair(uint64_t public_modulus, Ra
     return std::make_pair(c, d);
 }
 
+// payload bytes and their encoding: every element is ELEMENT_OFFSET + up to element_bytes little-endian bytes
+struct PipelineBlock {
+    std::vector<uint64_t> elements;
+    size_t bytes = 0;
+    size_t pending_slices = 0; // slices not yet through all four passes
+};
+
+// elements [begin, end) of a block, the unit of work of one thread
+struct PipelineSlice {
+    PipelineBlock *block;
+    size_t begin;
+    size_t end;
+};
+
+/*
+ * Streaming mode: the input is cut into blocks, each block into elements below p, and every element goes
+ * through the four passes x^c_a, x^c_b, x^d_a, x^d_b. The calling thread reads and writes while the workers,
+ * started once, take slices of the blocks in flight, so reading block i + 1, passing block i and writing
+ * block i - 1 overlap. Stats go to stderr, stdout may carry the output.
+ */
+class ShamirPipeline {
+public:
+    static constexpr size_t MIN_ELEMENTS_PER_SLICE = 1024; // smaller slices cost more in locking than in pow
+    static constexpr size_t BLOCKS_IN_FLIGHT = PASSES;
+
+    ShamirPipeline(uint64_t modulus, const std::array<uint64_t, PASSES> &exponents, size_t block_size,
+                   unsigned threads)
+            : ma_(modulus), exponents_(exponents), threads_(std::max(threads, 1u)) {
+        element_bytes_ = (bitLength(modulus) - 2) / 8; // keeps the largest element + ELEMENT_OFFSET below p - 1
+        if (element_bytes_ == 0) {
+            std::cerr << "Public modulus must be at least 512 to carry a byte per element" << std::endl;
+            exit(1);
+        }
+        block_bytes_ = std::max<size_t>(block_size / element_bytes_, MIN_ELEMENTS_PER_SLICE) * element_bytes_;
+    }
+
+    size_t elementBytes() const {
+        return element_bytes_;
+    }
+
+    size_t blockBytes() const {
+        return block_bytes_;
+    }
+
+    // bytes moved through all four passes, the SHA-256 of both ends must match
+    uint64_t transfer(FILE *input, FILE *output) {
+        std::deque<PipelineBlock> blocks; // in input order, references stay valid while the ends change
+        std::deque<PipelineSlice> slices;
+        std::vector<unsigned char> buffer(block_bytes_);
+        bool stopped = false;
+        uint64_t total = 0;
+
+        runThreads(threads_ + 1, [&](unsigned t) {
+            if (t != 0) {
+                work(slices, stopped);
+                return;
+            }
+            bool end_of_input = false;
+            while (true) {
+                while (!end_of_input && blocks.size() < BLOCKS_IN_FLIGHT) {
+                    PipelineBlock block;
+                    end_of_input = !read(input, buffer, block);
+                    if (!end_of_input) {
+                        enqueue(std::move(block), blocks, slices);
+                    }
+                }
+                if (blocks.empty()) {
+                    break;
+                }
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    block_done_.wait(lock, [&] { return blocks.front().pending_slices == 0; });
+                }
+                write(blocks.front(), buffer, output);
+                total += blocks.front().bytes;
+                std::lock_guard<std::mutex> lock(mutex_);
+                blocks.pop_front();
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped = true;
+            work_ready_.notify_all();
+        });
+        return total;
+    }
+
+    Sha256Digest inputDigest() {
+        return input_hash_.finalize();
+    }
+
+    Sha256Digest outputDigest() {
+        return output_hash_.finalize();
+    }
+
+private:
+    ModularArithmetic ma_;
+    std::array<uint64_t, PASSES> exponents_;
+    unsigned threads_;
+    size_t element_bytes_;
+    size_t block_bytes_;
+    Sha256 input_hash_;
+    Sha256 output_hash_;
+    std::mutex mutex_; // guards the blocks and slices of transfer()
+    std::condition_variable work_ready_;
+    std::condition_variable block_done_;
+
+    void enqueue(PipelineBlock &&block, std::deque<PipelineBlock> &blocks, std::deque<PipelineSlice> &slices) {
+        size_t count = block.elements.size();
+        size_t slice_count = std::max<size_t>(std::min<size_t>(threads_, count / MIN_ELEMENTS_PER_SLICE), 1);
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocks.push_back(std::move(block));
+        blocks.back().pending_slices = slice_count;
+        for (size_t i = 0; i < slice_count; ++i) {
+            slices.push_back({&blocks.back(), count * i / slice_count, count * (i + 1) / slice_count});
+        }
+        work_ready_.notify_all();
+    }
+
+    void work(std::deque<PipelineSlice> &slices, const bool &stopped) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            work_ready_.wait(lock, [&] { return stopped || !slices.empty(); });
+            if (slices.empty()) {
+                return;
+            }
+            PipelineSlice slice = slices.front();
+            slices.pop_front();
+            lock.unlock();
+            uint64_t *elements = slice.block->elements.data() + slice.begin;
+            for (size_t k = 0; k < PASSES; ++k) {
+                batchPow(ma_, elements, slice.end - slice.begin, exponents_[k], elements);
+            }
+            lock.lock();
+            if (--slice.block->pending_slices == 0) {
+                block_done_.notify_one();
+            }
+        }
+    }
+
+    bool read(FILE *input, std::vector<unsigned char> &buffer, PipelineBlock &block) {
+        block.bytes = fread(buffer.data(), 1, block_bytes_, input);
+        if (ferror(input)) {
+            std::cerr << "Read failed" << std::endl;
+            exit(1);
+        }
+        input_hash_.update(buffer.data(), block.bytes);
+        block.elements.resize((block.bytes + element_bytes_ - 1) / element_bytes_);
+        for (size_t i = 0; i < block.elements.size(); ++i) {
+            uint64_t value = 0;
+            for (size_t j = std::min(element_bytes_, block.bytes - i * element_bytes_); j-- > 0;) {
+                value = (value << 8) | buffer[i * element_bytes_ + j];
+            }
+            block.elements[i] = value + ELEMENT_OFFSET;
+        }
+        return block.bytes > 0;
+    }
+
+    void write(const PipelineBlock &block, std::vector<unsigned char> &buffer, FILE *output) {
+        for (size_t i = 0; i < block.elements.size(); ++i) {
+            uint64_t value = block.elements[i] - ELEMENT_OFFSET;
+            for (size_t j = 0; j < std::min(element_bytes_, block.bytes - i * element_bytes_); ++j, value >>= 8) {
+                buffer[i * element_bytes_ + j] = (unsigned char) value;
+            }
+        }
+        output_hash_.update(buffer.data(), block.bytes);
+        if (fwrite(buffer.data(), 1, block.bytes, output) != block.bytes) {
+            std::cerr << "Write failed" << std::endl;
+            exit(1);
+        }
+    }
+};
+
+void streamFile(const Args &args, Randomizer &randomizer) {
+    uint64_t modulus = args.public_modulus;
+    if (modulus == 0) {
+        modulus = randomizer.randomPrime((uint64_t) 1 << 63, UINT64_MAX);
+    }
+    auto [c_a, d_a] = generatePrivateKeyPair(modulus, randomizer);
+    auto [c_b, d_b] = generatePrivateKeyPair(modulus, randomizer);
+    ShamirPipeline pipeline(modulus, {c_a, c_b, d_a, d_b}, args.block_size, args.threads);
+
+    std::cerr << "Public modulus (p) = " << modulus << ", " << pipeline.elementBytes() << " bytes per element, "
+              << pipeline.blockBytes() << " bytes per block" << std::endl;
+    std::cerr << "Alice private key pair (c_a, d_a) = " << c_a << ", " << d_a << std::endl;
+    std::cerr << "Bob private key pair (c_b, d_b) = " << c_b << ", " << d_b << std::endl;
+
+    FILE *input = openStream(args.input_file, "rb", stdin);
+    FILE *output = openStream(args.output_file, "wb", stdout);
+    auto start_time = std::chrono::high_resolution_clock::now();
+    uint64_t total = pipeline.transfer(input, output);
+    closeStream(input, stdin);
+    closeStream(output, stdout);
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(end_time - start_time).count();
+    std::cerr << "Transferred " << total << " bytes in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() << " ms, "
+              << (uint64_t) ((double) total / std::max(seconds, 1e-9)) << " bytes/s, threads = " << args.threads
+              << std::endl;
+    if (pipeline.inputDigest() != pipeline.outputDigest()) {
+        std::cerr << "Bob received different bytes!" << std::endl;
+        exit(1);
+    }
+    std::cerr << "SHA-256 of the received bytes matches the input" << std::endl;
+}
+
 int main(int argc, char **argv) {
     Args args = parseArgs(argc, argv);
     Randomizer randomizer(args.seed);
 
+    if (!args.input_file.empty()) {
+        streamFile(args, randomizer);
+        return 0;
+    }
+
     uint64_t message = args.message;
     if (message >= args.public_modulus || message == 0) {
         message = randomizer.random(1, args.public_modulus - 1);